@@ -7,25 +7,44 @@
  * Full source at: https://github.com/rasmushugosson/log-lib
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
 #include <exception>
 #include <expected>
 #include <format>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <print>
 #include <source_location>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #ifdef AE_WINDOWS
 #include <Windows.h>
 #endif
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
 #undef ERROR
 
 constexpr const std::string_view c_LogLibVersion = "Log Lib Version 1.1.0";
@@ -41,61 +60,1120 @@ enum class LogLevel : uint8_t
     FATAL
 };
 
-struct LogMessage
+constexpr size_t c_LogLevelCount = static_cast<size_t>(LogLevel::FATAL) + 1;
+
+constexpr std::string_view GetFileName(std::string_view path) noexcept
+{
+    const auto pos = path.find_last_of("/\\");
+    return (pos == std::string_view::npos) ? path : path.substr(pos + 1);
+}
+
+// FNV-1a over the full path, position, level and format, stable between runs of the same build. A site that does not
+// keep its format hashes a marker in its place, so it never shares an id with one that does.
+constexpr uint64_t HashLogCallSite(std::string_view path, uint_least32_t line, uint_least32_t column, LogLevel level,
+                                   std::string_view format, bool keepsFormat = true) noexcept
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    const auto mix = [&hash](uint64_t value)
+    {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+
+    for (const char c : path)
+    {
+        mix(static_cast<unsigned char>(c));
+    }
+
+    mix(line);
+    mix(column);
+    mix(static_cast<uint64_t>(level));
+
+    if (keepsFormat)
+    {
+        for (const char c : format)
+        {
+            mix(static_cast<unsigned char>(c));
+        }
+
+        mix(format.size());
+    }
+
+    else
+    {
+        mix(~uint64_t{ 0 });
+    }
+
+    return hash;
+}
+
+// Everything about a log statement that is known at compile time. The log macros keep one static const instance per
+// call site, constant-initialized when the level and format are constants. Calls through the source_location
+// overloads of Logger::Log use an interned copy.
+struct LogCallSiteInfo
 {
     LogLevel level;
-    std::chrono::system_clock::time_point time;
-    std::string_view file;
+    std::string_view file; // Base name only
     std::string_view function;
     uint_least32_t line;
-    std::string message;
+    std::string_view format;
+    uint64_t id;
 };
 
-inline std::string_view GetFileName(std::string_view path) noexcept
+// Evaluated at compile time when the level and format are constants, which the log macros rely on
+constexpr LogCallSiteInfo MakeLogCallSiteInfo(LogLevel level, std::source_location loc, std::string_view format)
 {
-    const auto pos = path.find_last_of("/\\");
-    return (pos == std::string_view::npos) ? path : path.substr(pos + 1);
+    return LogCallSiteInfo{ .level = level,
+                            .file = GetFileName(loc.file_name()),
+                            .function = loc.function_name(),
+                            .line = loc.line(),
+                            .format = format,
+                            .id = HashLogCallSite(loc.file_name(), loc.line(), loc.column(), level, format) };
+}
+
+// The format of a log macro, either a string literal or a std::format_string passed on by a wrapper
+constexpr std::string_view GetLogFormat(std::string_view format) noexcept
+{
+    return format;
+}
+
+template <class... Args>
+constexpr std::string_view GetLogFormat(std::basic_format_string<char, Args...> format) noexcept
+{
+    return format.get();
+}
+
+// True if a call can use the descriptor of its macro expansion. A runtime level or a format passed on by a wrapper
+// may differ from the ones the descriptor was made with, such calls go through Logger::Log with a source_location.
+// Whether two evaluations of one string literal share an address is unspecified, so equal text also matches.
+constexpr bool IsLogCallSiteOf(const LogCallSiteInfo &site, LogLevel level, std::string_view format) noexcept
+{
+    return site.level == level && site.format.size() == format.size() &&
+           (site.format.data() == format.data() || site.format == format);
+}
+
+struct LogMessage
+{
+    const LogCallSiteInfo *site;
+    LogLevel level;
+    // A reading of Clock, see Clock::ToSystemTime for the wall time
+    std::chrono::steady_clock::time_point time;
+    // Borrows a buffer of the logging thread and is only valid during the sink call. Left empty when only binary
+    // sinks take the level.
+    std::string_view message;
+    // The typed arguments for binary sinks, see EncodeBinaryArgs. Empty when no binary sink takes the level or an
+    // argument can not be encoded, binary sinks then store the message text instead.
+    std::span<const std::byte> arguments;
+    // The keys and values of an AE_LOG_KV message, see EncodeLogFields. The site format is then the message itself.
+    // Empty for every other message.
+    std::span<const std::byte> fields;
+};
+
+#if defined(__cpp_lib_move_only_function) && __cpp_lib_move_only_function >= 202110L
+typedef std::move_only_function<void(const LogMessage &, std::string_view time) const &> LogSink;
+#else
+typedef std::function<void(const LogMessage &, std::string_view time) const &> callback LogSink;
+#endif
+
+enum class LogSinkConsoleKind : uint8_t
+{
+    STDOUT = 0,
+    STDERR,
+};
+
+// Line formats of Logger::AddStructuredFileSink
+enum class LogStructuredKind : uint8_t
+{
+    JSON = 0, // One JSON object per line
+    LOGFMT,   // key=value pairs separated by spaces
+};
+
+// Tuning for Logger::AddBufferedFileSink. Lines are collected in memory and written out in large batches once one
+// of the thresholds is reached, the Logger closing or Logger::Flush also write out whatever is pending. The interval
+// is checked on every write and by a background timer every half interval, so a quiet sink still writes out a line
+// within one and a half intervals.
+struct LogFileBufferOptions
+{
+    size_t bufferSize = 4 * 1024 * 1024;             // Lines longer than what is left are written together with it
+    size_t flushBytes = 1024 * 1024;                 // Write out once this much is pending
+    std::chrono::milliseconds flushInterval{ 1000 }; // Or once the oldest pending line is this old
+    LogLevel flushLevel = LogLevel::ERROR;           // Lines at or above this level are written out immediately
+};
+
+#ifdef AE_LINUX
+// Tuning for Logger::AddUringFileSink
+struct LogUringFileOptions
+{
+    size_t bufferSize = 256 * 1024; // Each full buffer is written with a single request
+    uint32_t bufferCount = 4;       // Producers only wait for the disk once this many buffers are being written
+    // A background timer submits a partly filled buffer at least this often, zero to only submit full ones
+    std::chrono::milliseconds flushInterval{ 1000 };
+};
+#endif // AE_LINUX
+
+// Rotation for Logger::AddFileSink. Each segment is named after the sink's path with a sequence number and the UTC
+// time it was started, such as logs/app.000003.20250101-120000.txt. Segments left by earlier runs are continued
+// from and count towards maxFiles.
+struct LogFileRotationOptions
+{
+    size_t maxBytes = 0;                // Start a new segment before this size would be exceeded, 0 disables
+    std::chrono::seconds interval{ 0 }; // Start a new segment once the current one is this old, 0 disables
+    uint32_t maxFiles = 0;              // Delete the oldest segments past this count, 0 keeps every segment
+};
+
+// Settings for Logger::EnableLoadShedding
+struct LogLoadSheddingOptions
+{
+    std::chrono::microseconds latencyBudget{ 500 }; // Average time the slowest sink may take to write one message
+    LogLevel maxShedLevel = LogLevel::INFO;          // Highest level that may be dropped, at most WARNING
+    std::chrono::milliseconds recoveryDelay{ 1000 }; // How long sinks must stay within budget before easing off
+};
+
+// Returns the text held by a file written by Logger::AddRingFileSink, oldest line first. The oldest line is left out
+// once the ring has wrapped since it was partly overwritten.
+std::string ReadRingLogFile(const std::string &path);
+
+// What a producer does when the async queue is full
+enum class AsyncOverflowPolicy : uint8_t
+{
+    BLOCK = 0,   // Wait for the backend thread to free a slot
+    DROP_NEWEST, // Discard the message being logged
+    DROP_OLDEST, // Discard the oldest queued message to make room
+};
+
+// Where the text of a message is produced once async logging is enabled
+enum class AsyncFormatMode : uint8_t
+{
+    EAGER = 0, // Format on the calling thread and queue the finished text
+    DEFERRED,  // Queue the raw arguments and format on the backend thread
+};
+
+enum class LogNewlineKind : uint8_t
+{
+    ALL = 0,
+    CONSOLE,
+    FILE,
+};
+
+class AsyncLogQueue;
+struct AsyncLogRecord;
+
+class SinkRegistry;
+struct LogSinkState;
+class StatsReporter;
+
+// Bumped whenever the set of levels accepted by any sink may have changed
+inline std::atomic<uint32_t> g_LogGeneration{ 1 };
+
+// Per call site cache of whether any sink accepts the level. The cached state packs the generation it was computed
+// for, the level and the result, so a hit costs one load of the record and one of g_LogGeneration.
+class LogCallSite
+{
+  public:
+    constexpr LogCallSite() = default;
+
+    [[nodiscard]] inline bool IsEnabled(LogLevel level)
+    {
+        const uint64_t state = m_State.load(std::memory_order_relaxed);
+        const uint64_t key = (static_cast<uint64_t>(g_LogGeneration.load(std::memory_order_relaxed)) << 8) |
+                             (static_cast<uint64_t>(level) << 1);
+
+        if ((state & ~uint64_t{ 1 }) == key)
+        {
+            return (state & 1) != 0;
+        }
+
+        return Refresh(level);
+    }
+
+  private:
+    bool Refresh(LogLevel level);
+
+  private:
+    std::atomic<uint64_t> m_State{ 0 };
+};
+
+// Per call site state of the sampling macros such as AE_LOG_EVERY_N, decides whether a message is logged before its
+// arguments are evaluated. Lock-free, with several threads on one call site the decisions are close but not exact.
+class LogSampler
+{
+  public:
+    constexpr LogSampler() = default;
+
+    // An n of 0 lets nothing through
+    [[nodiscard]] inline bool EveryN(uint64_t n)
+    {
+        return n != 0 && m_Count.fetch_add(1, std::memory_order_relaxed) % n == 0;
+    }
+
+    [[nodiscard]] inline bool Once()
+    {
+        return m_Count.load(std::memory_order_relaxed) == 0 && m_Count.exchange(1, std::memory_order_relaxed) == 0;
+    }
+
+    [[nodiscard]] inline bool EveryInterval(std::chrono::nanoseconds interval)
+    {
+        const int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        int64_t next = m_Next.load(std::memory_order_relaxed);
+
+        return now >= next && m_Next.compare_exchange_strong(next, now + interval.count(), std::memory_order_relaxed);
+    }
+
+    // Spaces messages evenly at the given rate and lets up to a second's worth through at once after a quiet period. A
+    // rate that is not above zero lets nothing through, rates below one a day are treated as one a day.
+    [[nodiscard]] inline bool RateLimited(double perSecond)
+    {
+        constexpr int64_t second = std::chrono::nanoseconds(std::chrono::seconds(1)).count();
+        constexpr auto maxInterval = static_cast<double>(std::chrono::nanoseconds(std::chrono::hours(24)).count());
+
+        // Also false for NaN
+        if (!(perSecond > 0.0))
+        {
+            return false;
+        }
+
+        const int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        const auto interval = static_cast<int64_t>(std::min(static_cast<double>(second) / perSecond, maxInterval));
+        const int64_t burst = std::max(interval, second);
+        int64_t next = m_Next.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            const int64_t after = std::max(next, now) + interval;
+
+            if (after - now > burst)
+            {
+                return false;
+            }
+
+            if (m_Next.compare_exchange_weak(next, after, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+    }
+
+  private:
+    std::atomic<uint64_t> m_Count{ 0 }; // Calls for EveryN and Once
+    std::atomic<int64_t> m_Next{ 0 };   // Steady clock time for the interval and rate
+};
+
+// Per call site state of AE_LOG_DEDUP, created and owned by the Logger so the repeats of a site that has gone quiet
+// are still written on Logger::Flush and when the Logger closes
+class LogDeduplicator
+{
+  public:
+    LogDeduplicator() = default;
+
+    LogDeduplicator(const LogDeduplicator &) = delete;
+    LogDeduplicator(LogDeduplicator &&) = delete;
+    LogDeduplicator &operator=(const LogDeduplicator &) = delete;
+    LogDeduplicator &operator=(LogDeduplicator &&) = delete;
+    ~LogDeduplicator() = default;
+
+    // False if message is the same as the previous one from this call site, otherwise true with repeated set to how
+    // often the previous message was left out since it was last reported
+    [[nodiscard]] bool Deduplicate(const LogCallSiteInfo &site, std::string_view message, uint64_t &repeated);
+    // The repeats not reported yet, which count as reported afterwards. site is left alone while nothing was logged.
+    [[nodiscard]] uint64_t TakeRepeated(const LogCallSiteInfo *&site);
+
+  private:
+    std::mutex m_Mutex;
+    std::string m_Previous; // Keeps its capacity, only a longer message allocates
+    bool m_HasPrevious = false;
+    uint64_t m_Repeated = 0;
+    const LogCallSiteInfo *m_Site = nullptr;
+};
+
+// Deferred formatting
+// ---------------------------------------------------------------------------------------------------------------------------------------
+
+// Rebuilds the arguments captured by EncodeDeferredArg and formats them into out
+typedef void (*DeferredDecodeFn)(std::string_view fmt, const std::byte *arguments, std::string &out);
+
+// Strings are copied inline as a length followed by the characters
+template <class T>
+concept DeferredString = std::is_convertible_v<const std::remove_cvref_t<T> &, std::string_view>;
+
+// Specialize as std::true_type for a trivially copyable type that holds everything it formats, so deferred formatting
+// may copy it by value
+template <class T> struct DeferredCopyable : std::false_type
+{
+};
+
+// Numbers, enums, void pointers and opted in types are copied by value. Anything else, such as a span, a view or a
+// struct holding a pointer, could refer to memory that is gone by the time the message is formatted.
+template <class T>
+concept DeferredValue =
+    !DeferredString<T> &&
+    (std::is_arithmetic_v<std::remove_cvref_t<T>> || std::is_enum_v<std::remove_cvref_t<T>> ||
+     std::is_null_pointer_v<std::remove_cvref_t<T>> || std::is_same_v<std::remove_cvref_t<T>, void *> ||
+     std::is_same_v<std::remove_cvref_t<T>, const void *> ||
+     (DeferredCopyable<std::remove_cvref_t<T>>::value && std::is_trivially_copyable_v<std::remove_cvref_t<T>>));
+
+template <class T>
+concept DeferredArg = DeferredString<T> || DeferredValue<T>;
+
+template <class T>
+using DeferredDecodedType = std::conditional_t<DeferredString<T>, std::string_view, std::remove_cvref_t<T>>;
+
+// How many messages the calling thread is writing to sinks right now, above 1 while a sink logs
+inline uint32_t &GetLogNestingDepth()
+{
+    thread_local uint32_t depth = 0;
+    return depth;
+}
+
+// The buffer of the current nesting depth. A sink that logs gets buffers of its own, so the message it was called
+// with keeps pointing at intact text. Buffers keep their capacity between calls.
+template <class Buffer> inline Buffer &GetNestedBuffer(std::deque<Buffer> &buffers)
+{
+    const uint32_t depth = GetLogNestingDepth();
+
+    while (buffers.size() <= depth)
+    {
+        buffers.emplace_back();
+    }
+
+    return buffers[depth];
+}
+
+inline std::vector<std::byte> &GetDeferredArgumentBuffer()
+{
+    thread_local std::deque<std::vector<std::byte>> buffers;
+    return GetNestedBuffer(buffers);
+}
+
+// Messages are formatted into a buffer owned by the logging thread, which keeps its capacity between calls
+inline std::string &GetFormatBuffer()
+{
+    thread_local std::deque<std::string> buffers;
+    return GetNestedBuffer(buffers);
+}
+
+template <DeferredArg T> inline void EncodeDeferredArg(std::vector<std::byte> &buffer, const T &arg)
+{
+    const size_t offset = buffer.size();
+
+    if constexpr (DeferredString<T>)
+    {
+        const std::string_view view{ arg };
+        const size_t size = view.size();
+
+        buffer.resize(offset + sizeof(size) + size);
+        std::memcpy(buffer.data() + offset, &size, sizeof(size));
+        std::memcpy(buffer.data() + offset + sizeof(size), view.data(), size);
+    }
+
+    else
+    {
+        buffer.resize(offset + sizeof(T));
+        std::memcpy(buffer.data() + offset, &arg, sizeof(T));
+    }
 }
 
-#if defined(__cpp_lib_move_only_function) && __cpp_lib_move_only_function >= 202110L
-typedef std::move_only_function<void(const LogMessage &) const &> LogSink;
-#else
-typedef std::function<void(const LogMessage &) const &> callback LogSink;
-#endif
+template <DeferredArg T> inline DeferredDecodedType<T> DecodeDeferredArg(const std::byte *&data)
+{
+    using Decoded = DeferredDecodedType<T>;
+
+    if constexpr (DeferredString<T>)
+    {
+        size_t size = 0;
+        std::memcpy(&size, data, sizeof(size));
+
+        const Decoded view{ reinterpret_cast<const char *>(data + sizeof(size)), size };
+        data += sizeof(size) + size;
+
+        return view;
+    }
+
+    else
+    {
+        std::array<std::byte, sizeof(Decoded)> bytes{};
+        std::memcpy(bytes.data(), data, sizeof(Decoded));
+        data += sizeof(Decoded);
+
+        return std::bit_cast<Decoded>(bytes);
+    }
+}
+
+template <DeferredArg... Args>
+void DecodeDeferred(std::string_view fmt, [[maybe_unused]] const std::byte *arguments, std::string &out)
+{
+    // Braced initialization guarantees the arguments are decoded left to right
+    std::tuple<DeferredDecodedType<Args>...> values{ DecodeDeferredArg<Args>(arguments)... };
+
+    std::apply([&](auto &...decoded)
+               { std::vformat_to(std::back_inserter(out), fmt, std::make_format_args(decoded...)); },
+               values);
+}
+
+// Binary log records
+// ---------------------------------------------------------------------------------------------------------------------------------------
+
+// Tag in front of every argument in a binary record
+enum class BinaryArgKind : uint8_t
+{
+    INT = 0, // Zigzag varint
+    UINT,    // Varint
+    FLOAT,   // 4 bytes
+    DOUBLE,  // 8 bytes
+    BOOL,    // 1 byte
+    CHAR,    // 1 byte
+    STRING,  // Varint length followed by the characters
+    POINTER, // Varint of the address
+};
+
+// Arguments the LogDecode tool can format again without knowing the types of the program that logged them
+template <class T>
+concept BinaryArg =
+    DeferredString<T> ||
+    (std::is_arithmetic_v<std::remove_cvref_t<T>> && !std::is_same_v<std::remove_cvref_t<T>, long double>) ||
+    std::is_same_v<std::remove_cvref_t<T>, void *> || std::is_same_v<std::remove_cvref_t<T>, const void *> ||
+    std::is_null_pointer_v<std::remove_cvref_t<T>>;
+
+inline void AppendBinaryVarint(std::vector<std::byte> &buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back(static_cast<std::byte>(value | 0x80));
+        value >>= 7;
+    }
+
+    buffer.push_back(static_cast<std::byte>(value));
+}
+
+template <BinaryArg T> inline void EncodeBinaryArg(std::vector<std::byte> &buffer, const T &arg)
+{
+    using Value = std::remove_cvref_t<T>;
+
+    const auto append = [&buffer](BinaryArgKind kind, const void *data, size_t size)
+    {
+        const size_t offset = buffer.size();
+        buffer.resize(offset + 1 + size);
+        buffer[offset] = static_cast<std::byte>(kind);
+        std::memcpy(buffer.data() + offset + 1, data, size);
+    };
+
+    if constexpr (DeferredString<T>)
+    {
+        const std::string_view view{ arg };
+        buffer.push_back(static_cast<std::byte>(BinaryArgKind::STRING));
+        AppendBinaryVarint(buffer, view.size());
+
+        const size_t offset = buffer.size();
+        buffer.resize(offset + view.size());
+        std::memcpy(buffer.data() + offset, view.data(), view.size());
+    }
+
+    else if constexpr (std::is_same_v<Value, bool> || std::is_same_v<Value, char>)
+    {
+        append(std::is_same_v<Value, bool> ? BinaryArgKind::BOOL : BinaryArgKind::CHAR, &arg, 1);
+    }
+
+    else if constexpr (std::is_integral_v<Value> && std::is_signed_v<Value>)
+    {
+        const auto value = static_cast<int64_t>(arg);
+        buffer.push_back(static_cast<std::byte>(BinaryArgKind::INT));
+        AppendBinaryVarint(buffer, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    else if constexpr (std::is_integral_v<Value>)
+    {
+        buffer.push_back(static_cast<std::byte>(BinaryArgKind::UINT));
+        AppendBinaryVarint(buffer, static_cast<uint64_t>(arg));
+    }
+
+    else if constexpr (std::is_same_v<Value, float>)
+    {
+        append(BinaryArgKind::FLOAT, &arg, sizeof(float));
+    }
+
+    else if constexpr (std::is_same_v<Value, double>)
+    {
+        append(BinaryArgKind::DOUBLE, &arg, sizeof(double));
+    }
+
+    else
+    {
+        buffer.push_back(static_cast<std::byte>(BinaryArgKind::POINTER));
+        AppendBinaryVarint(buffer, reinterpret_cast<uintptr_t>(static_cast<const void *>(arg)));
+    }
+}
+
+// Encodes the arguments of a message into a buffer reused by the calling thread, an argument count followed by each
+// tagged argument
+template <BinaryArg... Args> inline std::span<const std::byte> EncodeBinaryArgs(const Args &...args)
+{
+    static_assert(sizeof...(Args) <= 255, "Binary log records take at most 255 arguments");
+
+    thread_local std::deque<std::vector<std::byte>> buffers;
+    std::vector<std::byte> &buffer = GetNestedBuffer(buffers);
+    buffer.clear();
+    buffer.push_back(static_cast<std::byte>(sizeof...(Args)));
+    (EncodeBinaryArg(buffer, args), ...);
+
+    return buffer;
+}
+
+// Structured fields
+// ---------------------------------------------------------------------------------------------------------------------------------------
+
+// Values that are not a BinaryArg are formatted with std::format and stored as strings
+template <class T> inline void EncodeLogFieldValue(std::vector<std::byte> &buffer, const T &value)
+{
+    if constexpr (BinaryArg<T>)
+    {
+        EncodeBinaryArg(buffer, value);
+    }
+
+    else
+    {
+        thread_local std::string text;
+        text.clear();
+        std::format_to(std::back_inserter(text), "{}", value);
+        EncodeBinaryArg(buffer, std::string_view(text));
+    }
+}
+
+inline void EncodeLogFieldPairs(std::vector<std::byte> &)
+{
+}
+
+template <class Key, class Value, class... Rest>
+inline void EncodeLogFieldPairs(std::vector<std::byte> &buffer, const Key &key, const Value &value,
+                                const Rest &...rest)
+{
+    static_assert(DeferredString<Key>, "AE_LOG_KV keys must be strings");
+
+    EncodeBinaryArg(buffer, key);
+    EncodeLogFieldValue(buffer, value);
+    EncodeLogFieldPairs(buffer, rest...);
+}
+
+// Encodes alternating keys and values like EncodeBinaryArgs, into a buffer reused by the calling thread
+template <class... Fields> inline std::span<const std::byte> EncodeLogFields(const Fields &...fields)
+{
+    static_assert(sizeof...(Fields) % 2 == 0, "AE_LOG_KV takes a value after every key");
+    static_assert(sizeof...(Fields) <= 254, "AE_LOG_KV takes at most 127 fields");
+
+    thread_local std::deque<std::vector<std::byte>> buffers;
+    std::vector<std::byte> &buffer = GetNestedBuffer(buffers);
+    buffer.clear();
+    buffer.push_back(static_cast<std::byte>(sizeof...(Fields)));
+    EncodeLogFieldPairs(buffer, fields...);
+
+    return buffer;
+}
+
+// Incrementally turns the output of Logger::AddBinaryFileSink back into the text layout of Logger::AddFileSink. Bytes
+// can be fed in chunks of any size, each record is decoded as soon as it is complete.
+class BinaryLogDecoder
+{
+  public:
+    BinaryLogDecoder();
+    ~BinaryLogDecoder() = default;
+
+    // Appends the text of every record completed by data to out. Throws RuntimeError on malformed input.
+    void Feed(std::string_view data, std::string &out);
+
+  private:
+    struct Site
+    {
+        LogLevel level;
+        uint32_t line;
+        std::string file;
+        std::string function;
+        std::string format;
+    };
+
+    // Returns false without consuming anything if the record at the front is incomplete
+    bool DecodeRecord(std::string &out);
+
+  private:
+    std::string m_Pending;
+    size_t m_Offset;
+    bool m_HeaderRead;
+    int64_t m_LastTime;
+    std::vector<Site> m_Sites;
+};
+
+enum class ClockSource : uint8_t
+{
+    // std::chrono::steady_clock
+    STD = 0,
+    // CLOCK_MONOTONIC_COARSE, a few milliseconds of resolution for a fraction of the cost. Linux only.
+    COARSE,
+    // The invariant time stamp counter, calibrated against steady_clock. x86-64 only.
+    TSC
+};
+
+// Calibration of the time stamp counter, published by Clock::Select before the source is switched to TSC. Every
+// calibration is a new object, so a reading taken during a later Select still sees a whole one.
+struct ClockTscCalibration
+{
+    uint64_t counterBase = 0;
+    int64_t nanosBase = 0;
+    // Nanoseconds per tick as a 32.32 fixed point number
+    uint64_t nanosPerTick = 0;
+};
+
+inline std::atomic<ClockSource> g_ClockSource{ ClockSource::STD };
+inline std::atomic<const ClockTscCalibration *> g_ClockTscCalibration{ nullptr };
+
+// The clock behind log message timestamps and Timer. Readings are steady_clock time points whatever the source, so
+// they can be compared across a change of source up to the resolution of the coarser one.
+class Clock
+{
+  public:
+    // Switches every later reading to source and returns the source in use, which stays STD when the requested one is
+    // not available on this machine. Selecting TSC calibrates the counter for about 10 ms, which is best done once at
+    // startup. The measured rate is typically off by a few parts per million, up to about 0.01 % if the thread is
+    // preempted while calibrating. Durations taken from TSC readings, such as those of Timer and TimerStats, are off by
+    // the same share, and the readings drift away from steady_clock by it for as long as the process runs. Wall times
+    // are not affected, see ToSystemTime. Safe to call while other threads read the clock.
+    static ClockSource Select(ClockSource source);
+
+    [[nodiscard]] inline static ClockSource GetSource()
+    {
+        return g_ClockSource.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] inline static std::chrono::steady_clock::time_point Now()
+    {
+        switch (g_ClockSource.load(std::memory_order_acquire))
+        {
+#ifdef AE_LINUX
+        case ClockSource::COARSE:
+        {
+            timespec now{};
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+            return FromNanos(static_cast<int64_t>(now.tv_sec) * 1'000'000'000 + now.tv_nsec);
+        }
+#endif // AE_LINUX
+#if defined(__x86_64__) || defined(_M_X64)
+        case ClockSource::TSC:
+            return FromNanos(TscToNanos(ReadTsc()));
+#endif
+        default:
+            return std::chrono::steady_clock::now();
+        }
+    }
+
+    // Wall time of a reading. Each thread pairs a reading with the wall clock and refreshes the pair every second, so
+    // the calibration error of the counter never builds up.
+    [[nodiscard]] static std::chrono::system_clock::time_point ToSystemTime(std::chrono::steady_clock::time_point time);
+
+  private:
+    [[nodiscard]] inline static std::chrono::steady_clock::time_point FromNanos(int64_t nanos)
+    {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(nanos)));
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    [[nodiscard]] inline static uint64_t ReadTsc()
+    {
+#ifdef _MSC_VER
+        return __rdtsc();
+#else
+        return __builtin_ia32_rdtsc();
+#endif // _MSC_VER
+    }
+
+    [[nodiscard]] inline static int64_t TscToNanos(uint64_t counter)
+    {
+        // Published before the source was switched to TSC, which Now loads with acquire
+        const ClockTscCalibration &calibration = *g_ClockTscCalibration.load(std::memory_order_acquire);
+        const uint64_t ticks = counter - calibration.counterBase;
+
+        // (ticks * nanosPerTick) >> 32 without a 128-bit product
+        const uint64_t ticksHigh = ticks >> 32;
+        const uint64_t ticksLow = ticks & 0xFFFFFFFF;
+        const uint64_t nanos = ticksHigh * calibration.nanosPerTick + ticksLow * (calibration.nanosPerTick >> 32) +
+                               ((ticksLow * (calibration.nanosPerTick & 0xFFFFFFFF)) >> 32);
+
+        return calibration.nanosBase + static_cast<int64_t>(nanos);
+    }
+#endif
+};
+
+class Timer
+{
+  public:
+    Timer();
+    ~Timer() = default;
+
+    void Start();
+    void Stop();
+    void Reset();
+
+    [[nodiscard]] double GetElapsedTime() const;
+
+    template <class Dur = std::chrono::duration<double>> [[nodiscard]] inline Dur GetElapsedTimeAs() const
+    {
+        if (m_Running)
+        {
+            return std::chrono::duration_cast<Dur>(m_ElapsedTime + (Clock::Now() - m_Start));
+        }
+        return std::chrono::duration_cast<Dur>(m_ElapsedTime);
+    }
+
+    [[nodiscard]] std::string GetElapsedTimeAsString(int32_t decimals) const;
+
+  private:
+    std::chrono::steady_clock::time_point m_Start;
+    std::chrono::steady_clock::duration m_ElapsedTime;
+    bool m_Running;
+};
+
+// A zone of AE_PROFILE_SCOPE, one constant per expansion
+struct ProfileZoneInfo
+{
+    std::string_view name;
+    std::string_view file; // Base name only
+    uint_least32_t line;
+};
+
+consteval ProfileZoneInfo MakeProfileZoneInfo(std::string_view name, std::source_location loc)
+{
+    return ProfileZoneInfo{ .name = name, .file = GetFileName(loc.file_name()), .line = loc.line() };
+}
+
+struct ProfileEvent
+{
+    const ProfileZoneInfo *zone;
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+};
+
+// The events of one thread in the current capture. Only the owning thread appends, and it publishes the count after
+// each event so the trace can be written while threads keep recording.
+struct ProfileBuffer
+{
+    std::unique_ptr<ProfileEvent[]> events;
+    size_t capacity = 0;
+    std::atomic<size_t> count{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint32_t> capture{ 0 };
+    uint32_t threadId = 0;
+
+    inline void Push(const ProfileEvent &event)
+    {
+        const size_t index = count.load(std::memory_order_relaxed);
+
+        if (index == capacity)
+        {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        events[index] = event;
+        count.store(index + 1, std::memory_order_release);
+    }
+};
+
+inline std::atomic<bool> g_ProfilerEnabled{ false };
+inline std::atomic<uint32_t> g_ProfilerCapture{ 0 };
+
+inline ProfileBuffer *&GetProfileBuffer()
+{
+    thread_local ProfileBuffer *buffer = nullptr;
+    return buffer;
+}
+
+// Collects AE_PROFILE_SCOPE zones into per-thread buffers and writes them as a Chrome trace
+class Profiler
+{
+  public:
+    // Starts a new capture and drops the events of the previous one. Each thread that enters a zone gets room for
+    // eventsPerThread events, the ones after that are counted as dropped.
+    static void Start(size_t eventsPerThread = 64 * 1024);
+    // Zones entered after this only cost a load and a branch. The recorded events stay until the next Start.
+    static void Stop();
+
+    [[nodiscard]] inline static bool IsEnabled()
+    {
+        return g_ProfilerEnabled.load(std::memory_order_relaxed);
+    }
+
+    // Writes the capture in the Chrome trace event format, which Perfetto and chrome://tracing open. Can be called
+    // while threads record, the file then holds the zones that had ended.
+    static void WriteTrace(const std::string &path);
+
+    [[nodiscard]] static uint64_t GetDroppedEventCount();
+
+    inline static void Record(const ProfileZoneInfo &zone, std::chrono::steady_clock::time_point begin,
+                              std::chrono::steady_clock::time_point end)
+    {
+        ProfileBuffer *buffer = GetProfileBuffer();
+
+        if (buffer == nullptr ||
+            buffer->capture.load(std::memory_order_relaxed) != g_ProfilerCapture.load(std::memory_order_relaxed))
+        {
+            buffer = AttachBuffer();
+        }
+
+        buffer->Push(ProfileEvent{ .zone = &zone, .begin = begin, .end = end });
+    }
+
+  private:
+    // Gives the calling thread a buffer for the current capture, once per thread and capture
+    static ProfileBuffer *AttachBuffer();
+};
+
+// Records the time between construction and destruction as a zone while the profiler runs
+class ProfileScope
+{
+  public:
+    inline explicit ProfileScope(const ProfileZoneInfo &zone)
+        : m_Zone(Profiler::IsEnabled() ? &zone : nullptr), m_Begin()
+    {
+        if (m_Zone != nullptr)
+        {
+            m_Begin = Clock::Now();
+        }
+    }
+
+    inline ~ProfileScope()
+    {
+        if (m_Zone != nullptr)
+        {
+            Profiler::Record(*m_Zone, m_Begin, Clock::Now());
+        }
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope(ProfileScope &&) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+    ProfileScope &operator=(ProfileScope &&) = delete;
+
+  private:
+    const ProfileZoneInfo *m_Zone;
+    std::chrono::steady_clock::time_point m_Begin;
+};
+
+struct LatencySummary
+{
+    uint64_t count = 0;
+    std::chrono::nanoseconds total{};
+    std::chrono::nanoseconds mean{};
+    std::chrono::nanoseconds min{};
+    std::chrono::nanoseconds max{};
+    std::chrono::nanoseconds p50{};
+    std::chrono::nanoseconds p90{};
+    std::chrono::nanoseconds p99{};
+    std::chrono::nanoseconds p999{};
+};
+
+// Log-linear histogram of durations in nanoseconds. Every power of two is split into 32 buckets, so a percentile is
+// off by at most about 3 %. Only one thread may record at a time, but any thread can read or Add it meanwhile, the
+// counters are atomics that are only ever loaded and stored.
+class LatencyHistogram
+{
+  public:
+    static constexpr uint32_t c_SubBucketBits = 5;
+    static constexpr uint32_t c_SubBucketCount = 1u << c_SubBucketBits;
+    // Durations from 2^40 ns, about 18 minutes, on all land in the last bucket
+    static constexpr uint32_t c_MaxBits = 40;
+    static constexpr size_t c_BucketCount = (c_MaxBits - c_SubBucketBits + 1) * c_SubBucketCount;
+
+    LatencyHistogram();
+
+    inline void Record(uint64_t nanos)
+    {
+        Increase(m_Buckets[BucketIndex(nanos)], 1);
+        Increase(m_Count, 1);
+        Increase(m_Sum, nanos);
+
+        if (nanos < m_Min.load(std::memory_order_relaxed))
+        {
+            m_Min.store(nanos, std::memory_order_relaxed);
+        }
+
+        if (nanos > m_Max.load(std::memory_order_relaxed))
+        {
+            m_Max.store(nanos, std::memory_order_relaxed);
+        }
+    }
+
+    // For a histogram that several threads record into, at the cost of atomic read-modify-writes
+    inline void RecordShared(uint64_t nanos)
+    {
+        m_Buckets[BucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+        m_Count.fetch_add(1, std::memory_order_relaxed);
+        m_Sum.fetch_add(nanos, std::memory_order_relaxed);
+
+        uint64_t min = m_Min.load(std::memory_order_relaxed);
+        while (nanos < min && !m_Min.compare_exchange_weak(min, nanos, std::memory_order_relaxed))
+        {
+        }
+
+        uint64_t max = m_Max.load(std::memory_order_relaxed);
+        while (nanos > max && !m_Max.compare_exchange_weak(max, nanos, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Adds the samples of other, which may be recording at the same time
+    void Add(const LatencyHistogram &other);
+    // Takes away the samples of an earlier copy of this histogram. Min and max are then only known to their bucket.
+    void Subtract(const LatencyHistogram &earlier);
+    void Clear();
+
+    [[nodiscard]] inline uint64_t GetCount() const
+    {
+        return m_Count.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] LatencySummary Summarize() const;
+
+    [[nodiscard]] inline static size_t BucketIndex(uint64_t nanos)
+    {
+        if (nanos < c_SubBucketCount)
+        {
+            return static_cast<size_t>(nanos);
+        }
+
+        const uint32_t topBit = static_cast<uint32_t>(std::bit_width(nanos)) - 1;
+
+        if (topBit >= c_MaxBits)
+        {
+            return c_BucketCount - 1;
+        }
+
+        const uint64_t subBucket = (nanos >> (topBit - c_SubBucketBits)) - c_SubBucketCount;
+        return (topBit - c_SubBucketBits + 1) * c_SubBucketCount + static_cast<size_t>(subBucket);
+    }
+
+  private:
+    // Only the recording thread writes, so a load and a store are enough
+    inline static void Increase(std::atomic<uint64_t> &counter, uint64_t amount)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, c_BucketCount> m_Buckets;
+    std::atomic<uint64_t> m_Count;
+    std::atomic<uint64_t> m_Sum;
+    std::atomic<uint64_t> m_Min;
+    std::atomic<uint64_t> m_Max;
+};
+
+inline std::vector<LatencyHistogram *> &GetTimerStatsHistograms()
+{
+    thread_local std::vector<LatencyHistogram *> histograms;
+    return histograms;
+}
+
+// Durations collected under a name, each thread records into a histogram of its own without locks. Summaries merge
+// the histograms of all threads, see Logger::LogTimerStats and Logger::EnableTimerStatsReport.
+class TimerStats
+{
+  public:
+    // The statistics called name, created on first use. The name is not copied and has to stay valid for the life of
+    // the program, as a string literal does. Look it up once and keep the reference, AE_TIMER_STATS_SCOPE does.
+    static TimerStats &Get(std::string_view name);
+    // Every registered statistics in the order they were created
+    static std::vector<TimerStats *> GetAll();
+
+    TimerStats(const TimerStats &) = delete;
+    TimerStats(TimerStats &&) = delete;
+    TimerStats &operator=(const TimerStats &) = delete;
+    TimerStats &operator=(TimerStats &&) = delete;
+    ~TimerStats() = default;
+
+    inline void Record(std::chrono::nanoseconds duration)
+    {
+        std::vector<LatencyHistogram *> &histograms = GetTimerStatsHistograms();
+        LatencyHistogram *histogram = m_Index < histograms.size() ? histograms[m_Index] : nullptr;
+
+        if (histogram == nullptr)
+        {
+            histogram = &AttachHistogram();
+        }
+
+        histogram->Record(static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)));
+    }
+
+    [[nodiscard]] inline std::string_view GetName() const
+    {
+        return m_Name;
+    }
+
+    // All durations recorded since the program started
+    [[nodiscard]] LatencySummary GetSummary() const;
+    // The durations recorded since the previous call, for periodic reports
+    [[nodiscard]] LatencySummary TakeIntervalSummary();
+
+  private:
+    TimerStats(std::string_view name, size_t index);
+
+    // Gives the calling thread a histogram, once per thread
+    LatencyHistogram &AttachHistogram();
+    // Callers hold the registry lock
+    void Merge(LatencyHistogram &total) const;
+    // Called when a thread exits, with the registry lock held
+    static void Release(TimerStats &stats, LatencyHistogram *histogram);
 
-enum class LogSinkConsoleKind : uint8_t
-{
-    STDOUT = 0,
-    STDERR,
+  private:
+    std::string_view m_Name;
+    size_t m_Index;
+
+    // Guarded by the registry lock. Histograms of exited threads are added to m_Retired and handed to new threads.
+    std::vector<std::unique_ptr<LatencyHistogram>> m_Histograms;
+    std::vector<LatencyHistogram *> m_FreeHistograms;
+    std::unique_ptr<LatencyHistogram> m_Retired;
+    std::unique_ptr<LatencyHistogram> m_LastInterval;
 };
 
-class Timer
+// Records the time between construction and destruction into stats
+class TimerStatsScope
 {
   public:
-    Timer();
-    ~Timer() = default;
-
-    void Start();
-    void Stop();
-    void Reset();
+    inline explicit TimerStatsScope(TimerStats &stats) : m_Stats(stats), m_Begin(Clock::Now()) {}
 
-    [[nodiscard]] double GetElapsedTime() const;
-
-    template <class Dur = std::chrono::duration<double>> [[nodiscard]] inline Dur GetElapsedTimeAs() const
+    inline ~TimerStatsScope()
     {
-        if (m_Running)
-        {
-            return std::chrono::duration_cast<Dur>(m_ElapsedTime + (std::chrono::steady_clock::now() - m_Start));
-        }
-        return std::chrono::duration_cast<Dur>(m_ElapsedTime);
+        m_Stats.Record(Clock::Now() - m_Begin);
     }
 
-    [[nodiscard]] std::string GetElapsedTimeAsString(int32_t decimals) const;
+    TimerStatsScope(const TimerStatsScope &) = delete;
+    TimerStatsScope(TimerStatsScope &&) = delete;
+    TimerStatsScope &operator=(const TimerStatsScope &) = delete;
+    TimerStatsScope &operator=(TimerStatsScope &&) = delete;
 
   private:
-    std::chrono::steady_clock::time_point m_Start;
-    std::chrono::steady_clock::duration m_ElapsedTime;
-    bool m_Running;
+    TimerStats &m_Stats;
+    std::chrono::steady_clock::time_point m_Begin;
+};
+
+struct LogLevelStats
+{
+    uint64_t written = 0;  // Handed to at least one sink
+    uint64_t filtered = 0; // Reached the Logger but no sink takes the level, see Logger::GetStats
+};
+
+struct LogSinkStats
+{
+    std::string name;
+    uint64_t messages = 0;
+    // What the sink wrote for its messages, lines for text sinks and records for binary sinks. Always 0 for callback
+    // sinks.
+    uint64_t bytes = 0;
+    // Of each call to the sink, only recorded while Logger::EnableSinkLatencyStats is on
+    LatencySummary latency;
+};
+
+// What the Logger has done since it was created, see Logger::GetStats
+struct LoggerStats
+{
+    std::array<LogLevelStats, c_LogLevelCount> levels{};
+    std::vector<LogSinkStats> sinks; // The sinks registered at the time, in registration order
+    uint64_t asyncDropped = 0;
+    uint64_t shed = 0;
 };
 
 class Logger
@@ -117,81 +1195,304 @@ class Logger
     }
 
     template <class... Args>
-    inline void Log(LogLevel level, std::source_location loc, std::format_string<Args...> fmt, Args &&...args) const
+    inline void Log(const LogCallSiteInfo &site, std::format_string<Args...> fmt, Args &&...args) const
     {
-        std::string message;
-        message.reserve(128);
-        std::format_to(std::back_inserter(message), fmt, std::forward<Args>(args)...);
+        if (IsShed(site.level))
+        {
+            return;
+        }
+
+        std::span<const std::byte> binaryArguments;
+
+        // Messages with more arguments than a record can count are stored as text
+        if constexpr ((BinaryArg<Args> && ...) && sizeof...(Args) <= 255)
+        {
+            const uint32_t levelBit = 1u << static_cast<uint32_t>(site.level);
+
+            if ((m_BinaryLevels.load(std::memory_order_relaxed) & levelBit) != 0)
+            {
+                binaryArguments = EncodeBinaryArgs(args...);
+
+                // Nothing left to format for if binary sinks are the only ones taking the level
+                if ((m_TextLevels.load(std::memory_order_relaxed) & levelBit) == 0)
+                {
+                    Dispatch(LogMessage{ .site = &site,
+                                         .level = site.level,
+                                         .time = Clock::Now(),
+                                         .message = {},
+                                         .arguments = binaryArguments,
+                                         .fields = {} });
+                    return;
+                }
+            }
+        }
 
-        auto file = GetFileName(std::string_view{ loc.file_name() });
+        if constexpr ((DeferredArg<Args> && ...))
+        {
+            // A level no sink takes only reaches here for the backtrace, which formats it only if it is written
+            if (m_DeferredFormatting.load(std::memory_order_relaxed) || !IsLevelEnabled(site.level))
+            {
+                std::vector<std::byte> &arguments = GetDeferredArgumentBuffer();
+                arguments.clear();
+                (EncodeDeferredArg(arguments, args), ...);
+
+                DispatchDeferred(LogMessage{ .site = &site,
+                                             .level = site.level,
+                                             .time = Clock::Now(),
+                                             .message = {},
+                                             .arguments = binaryArguments,
+                                             .fields = {} },
+                                 &DecodeDeferred<Args...>, arguments);
+                return;
+            }
+        }
 
-        LogMessage logMessage{ .level = level,
-                               .time = std::chrono::system_clock::now(),
-                               .file = file,
-                               .function = loc.function_name(),
-                               .line = loc.line(),
-                               .message = std::move(message) };
+        std::string_view message = fmt.get();
 
-        for (const auto &[name, sink] : m_Sinks)
+        // Without arguments or escaped braces the format string already is the message
+        if (sizeof...(Args) != 0 || message.find_first_of("{}") != std::string_view::npos)
         {
-            sink(logMessage);
+            std::string &buffer = GetFormatBuffer();
+            buffer.clear();
+            std::format_to(std::back_inserter(buffer), fmt, std::forward<Args>(args)...);
+            message = buffer;
         }
+
+        Dispatch(LogMessage{ .site = &site,
+                             .level = site.level,
+                             .time = Clock::Now(),
+                             .message = message,
+                             .arguments = binaryArguments,
+                             .fields = {} });
     }
 
-    inline void Log(LogLevel level, std::source_location loc, std::string_view fmt, std::format_args args) const
+    // Backs AE_LOG_KV, the site format is the message and fields alternate between keys and values
+    template <class... Fields> inline void LogFields(const LogCallSiteInfo &site, const Fields &...fields) const
     {
-        std::string message;
-        message.reserve(128);
-        std::vformat_to(std::back_inserter(message), fmt, args);
+        if (IsShed(site.level))
+        {
+            return;
+        }
+
+        Dispatch(LogMessage{ .site = &site,
+                             .level = site.level,
+                             .time = Clock::Now(),
+                             .message = {},
+                             .arguments = {},
+                             .fields = EncodeLogFields(fields...) });
+    }
+
+    // Backs AE_LOG_DEDUP, a message equal to the previous one from the site is only counted. The count is logged as
+    // its own message once the site logs something different, on Flush and when the Logger closes.
+    template <class... Args>
+    inline void LogDeduplicated(const LogCallSiteInfo &site, LogDeduplicator &deduplicator,
+                                std::format_string<Args...> fmt, Args &&...args) const
+    {
+        if (IsShed(site.level))
+        {
+            return;
+        }
+
+        std::string &message = GetFormatBuffer();
+        message.clear();
+        std::format_to(std::back_inserter(message), fmt, std::forward<Args>(args)...);
+
+        uint64_t repeated = 0;
 
-        auto file = GetFileName(std::string_view{ loc.file_name() });
+        if (!deduplicator.Deduplicate(site, message, repeated))
+        {
+            return;
+        }
 
-        LogMessage logMessage{ .level = level,
-                               .time = std::chrono::system_clock::now(),
-                               .file = file,
-                               .function = loc.function_name(),
-                               .line = loc.line(),
-                               .message = std::move(message) };
+        const auto time = Clock::Now();
 
-        for (const auto &[name, sink] : m_Sinks)
+        if (repeated != 0)
         {
-            sink(logMessage);
+            DispatchRepeated(site, repeated, time);
         }
+
+        Dispatch(LogMessage{ .site = &site,
+                             .level = site.level,
+                             .time = time,
+                             .message = message,
+                             .arguments = {},
+                             .fields = {} });
     }
 
-    inline void Newline() const
+    // For AE_LOG_KV calls with a runtime level. The message has to stay valid for the life of the program.
+    template <class... Fields>
+    inline void LogFields(LogLevel level, std::source_location loc, std::string_view msg, const Fields &...fields) const
+    {
+        LogFields(InternCallSite(level, loc, msg), fields...);
+    }
+
+    template <class... Args>
+    inline void Log(LogLevel level, std::source_location loc, std::format_string<Args...> fmt, Args &&...args) const
+    {
+        Log(InternCallSite(level, loc, fmt.get()), fmt, std::forward<Args>(args)...);
+    }
+
+    inline void Log(LogLevel level, std::source_location loc, std::string_view fmt, std::format_args args) const
     {
-        for (const auto &[name, stream] : m_Streams)
+        if (IsShed(level))
         {
-            std::println(stream, "");
+            return;
         }
+
+        std::string &message = GetFormatBuffer();
+        message.clear();
+        std::vformat_to(std::back_inserter(message), fmt, args);
+
+        // The format string is not guaranteed to outlive the call, so it is left out of the interned site
+        const LogCallSiteInfo &site = InternCallSite(level, loc, fmt, false);
+
+        Dispatch(LogMessage{ .site = &site,
+                             .level = level,
+                             .time = Clock::Now(),
+                             .message = message,
+                             .arguments = {},
+                             .fields = {} });
+    }
+
+    // The state of one AE_LOG_DEDUP call site, which lives as long as the Logger
+    LogDeduplicator &AddDeduplicator();
+
+    inline void Newline() const
+    {
+        DispatchNewline(LogNewlineKind::ALL);
     }
 
     inline void NewlineConsole() const
     {
-        for (const auto &[name, stream] : m_Streams)
-        {
-            if (stream == stdout || stream == stderr)
-            {
-                std::println(stream, "");
-            }
-        }
+        DispatchNewline(LogNewlineKind::CONSOLE);
     }
 
     inline void NewlineFile() const
     {
-        for (const auto &[name, stream] : m_FileStreams)
-        {
-            std::println(stream, "");
-        }
+        DispatchNewline(LogNewlineKind::FILE);
     }
 
     void AddConsoleSink(const std::string &name, LogSinkConsoleKind type = LogSinkConsoleKind::STDOUT,
                         LogLevel minLevel = LogLevel::TRACE, LogLevel maxLevel = LogLevel::FATAL);
     void AddFileSink(const std::string &name, const std::string &path, LogLevel minLevel = LogLevel::TRACE,
                      LogLevel maxLevel = LogLevel::FATAL);
+    // Splits the file into segments as set by the rotation options, a helper thread prepares the next segment so the
+    // logging path never waits for the file system when rotating
+    void AddFileSink(const std::string &name, const std::string &path, const LogFileRotationOptions &rotation,
+                     LogLevel minLevel = LogLevel::TRACE, LogLevel maxLevel = LogLevel::FATAL);
+    // Like AddFileSink but bypasses stdio and writes through its own buffer, see LogFileBufferOptions. With async
+    // logging enabled the backend thread also writes out everything pending whenever it runs out of messages.
+    void AddBufferedFileSink(const std::string &name, const std::string &path,
+                             const LogFileBufferOptions &options = {}, LogLevel minLevel = LogLevel::TRACE,
+                             LogLevel maxLevel = LogLevel::FATAL);
+#ifdef AE_LINUX
+    // Like AddFileSink but hands full buffers to io_uring, so writing to disk overlaps with the program instead of
+    // blocking in write(2). Falls back to pwrite from the logging thread if io_uring is unavailable. Logger::Flush
+    // waits for every submitted write to complete.
+    void AddUringFileSink(const std::string &name, const std::string &path, const LogUringFileOptions &options = {},
+                          LogLevel minLevel = LogLevel::TRACE, LogLevel maxLevel = LogLevel::FATAL);
+#endif // AE_LINUX
+    // Writes a compact binary file instead of text. Every call site is described once in the file, after that a
+    // message only stores the call site, the time since the previous message and its raw arguments. Messages whose
+    // arguments are all numbers, characters, strings or void pointers are not formatted at all when binary sinks are
+    // the only ones taking their level. Turn the file back into text with BinaryLogDecoder or the LogDecode tool.
+    void AddBinaryFileSink(const std::string &name, const std::string &path, LogLevel minLevel = LogLevel::TRACE,
+                           LogLevel maxLevel = LogLevel::FATAL);
+    // Writes one machine readable line per message, see LogStructuredKind. AE_LOG_KV fields are written as their own
+    // keys with numbers and booleans kept unquoted, other sinks show them as key=value pairs after the message. The
+    // open and close messages and newlines are left out so every line parses.
+    void AddStructuredFileSink(const std::string &name, const std::string &path,
+                               LogStructuredKind kind = LogStructuredKind::JSON, LogLevel minLevel = LogLevel::TRACE,
+                               LogLevel maxLevel = LogLevel::FATAL);
+    // Writes into a memory-mapped file of a fixed size that wraps around, keeping the newest capacity bytes of text.
+    // Writing costs a copy into the mapping without any system calls, and the text survives the process crashing. A
+    // file left by an earlier run with the same capacity is continued. Read it back with ReadRingLogFile or LogReader.
+    void AddRingFileSink(const std::string &name, const std::string &path, size_t capacity = 16 * 1024 * 1024,
+                         LogLevel minLevel = LogLevel::TRACE, LogLevel maxLevel = LogLevel::FATAL);
+    // Hands every message in range to sink, on the logging thread or the async backend thread. The message and time
+    // are only valid during the call. Open, close and termination messages and newlines are not passed on. Adding,
+    // removing or changing sinks from inside sink throws a LogicError.
+    void AddCallbackSink(const std::string &name, LogSink sink, LogLevel minLevel = LogLevel::TRACE,
+                         LogLevel maxLevel = LogLevel::FATAL);
 
     void RemoveSink(const std::string &name);
+    void SetSinkLevels(const std::string &name, LogLevel minLevel, LogLevel maxLevel = LogLevel::FATAL);
+
+    // True if at least one sink accepts the level
+    [[nodiscard]] inline bool IsLevelEnabled(LogLevel level) const
+    {
+        return (m_EnabledLevels.load(std::memory_order_acquire) & (1u << static_cast<uint32_t>(level))) != 0;
+    }
+
+    // True if the level is kept by the backtrace when no sink accepts it, see EnableBacktrace
+    [[nodiscard]] inline bool IsLevelInBacktrace(LogLevel level) const
+    {
+        return (m_BacktraceLevels.load(std::memory_order_acquire) & (1u << static_cast<uint32_t>(level))) != 0;
+    }
+
+    // Moves all sink writes onto a background thread. Log calls only push the finished message into a bounded
+    // lock-free queue of the given capacity (rounded up to a power of two). Can only be enabled once, the queue is
+    // drained when the Logger closes. With AsyncFormatMode::DEFERRED the calling thread only copies the arguments
+    // (strings, numbers, enums and void pointers, see DeferredValue) and formatting happens on the backend thread,
+    // messages with other argument types are still formatted eagerly.
+    void EnableAsync(size_t capacity = 8192, AsyncOverflowPolicy policy = AsyncOverflowPolicy::BLOCK,
+                     AsyncFormatMode formatMode = AsyncFormatMode::EAGER);
+
+    // Blocks until every message queued before the call has been written and the file streams are flushed
+    void Flush();
+
+    // Opt-in safety net for sinks that buffer. When the process dies from a fatal signal or std::terminate, every sink
+    // writes out what it still buffers followed by a line naming the cause, using only write(2). Messages still in
+    // the async queue are lost. Handlers installed before are called afterwards. The stdio buffers of console, file,
+    // structured and binary sinks are only reachable with glibc.
+    void InstallCrashHandler();
+
+    [[nodiscard]] inline bool IsAsync() const
+    {
+        return m_AsyncQueue.load(std::memory_order_acquire) != nullptr;
+    }
+
+    [[nodiscard]] inline uint64_t GetDroppedMessageCount() const
+    {
+        return m_AsyncDropped.load(std::memory_order_relaxed);
+    }
+
+    // Times every sink write and keeps a moving average per sink. While the slowest sink is over the latency budget
+    // the lowest levels are dropped before they are formatted, one more level at a time up to maxShedLevel. Levels
+    // come back one at a time once the sinks have stayed within budget for the recovery delay. A warning is written
+    // when dropping starts and a summary with the number of dropped messages once it ends. Calling it again replaces
+    // the options.
+    void EnableLoadShedding(const LogLoadSheddingOptions &options = {});
+
+    // Messages dropped by load shedding since the Logger was created
+    [[nodiscard]] inline uint64_t GetShedMessageCount() const
+    {
+        return m_ShedMessages.load(std::memory_order_relaxed);
+    }
+
+    // Keeps the last capacity messages of each thread whose level no sink takes, up to but not including
+    // triggerLevel. Keeping one only copies its arguments, it is formatted once a message at or above triggerLevel
+    // is logged on the same thread, which writes the thread's backtrace ahead of itself to the sinks taking its level.
+    // A message that any sink takes is written as usual and not kept, so with sinks at different levels a sink only
+    // gets the backtrace of levels that no sink takes. A capacity of 0 turns the backtrace off again.
+    void EnableBacktrace(size_t capacity = 64, LogLevel triggerLevel = LogLevel::ERROR);
+
+    // Logs one line per TimerStats with the count, mean, min, max and percentiles of everything recorded so far
+    void LogTimerStats(LogLevel level = LogLevel::INFO) const;
+    // Logs one line per TimerStats every interval from a thread of its own, covering the durations recorded since the
+    // previous report. Statistics without new durations are left out. An interval of zero stops the reports.
+    void EnableTimerStatsReport(std::chrono::milliseconds interval, LogLevel level = LogLevel::INFO);
+
+    // Message counts per level and per sink, the bytes each sink wrote, sink latencies and dropped messages. Counting
+    // is always on, each thread counts levels on its own and each sink counts its messages. Call sites skip levels no
+    // sink takes before reaching the Logger, so only messages that still had to be looked at, such as those kept by
+    // the backtrace, count as filtered.
+    [[nodiscard]] LoggerStats GetStats() const;
+    // Times every sink call into a histogram per sink, which costs a clock read per sink and message
+    void EnableSinkLatencyStats(bool enabled = true);
+    // Logs a line every interval with the messages written, filtered and dropped since the previous line, and for
+    // every sink its messages, bytes and the share of the interval spent in it. An interval of zero stops it.
+    void EnableHealthReport(std::chrono::milliseconds interval, LogLevel level = LogLevel::INFO);
 
     inline void SetOpenMessage(const std::string &message)
     {
@@ -201,20 +1502,111 @@ class Logger
   private:
     void Close();
 
-    void PrintOpenMessage(FILE *stream) const;
-    void PrintCloseMessage(FILE *stream) const;
-    void PrintTerminationMessage(FILE *stream) const;
+    [[nodiscard]] inline bool IsShed(LogLevel level) const
+    {
+        return static_cast<uint8_t>(level) < m_ShedLevels.load(std::memory_order_relaxed) && ShedMessage(level);
+    }
+
+    [[nodiscard]] bool ShedMessage(LogLevel level) const;
+    void UpdateLoadShedding(int64_t slowestNanos, int64_t now) const;
+    void WriteSheddingNotice(std::string_view text) const;
+
+    // Keeps a message no sink takes in the calling thread's backtrace and writes the backtrace ahead of a message at
+    // the trigger level. Returns true if the message was kept.
+    [[nodiscard]] bool UpdateBacktrace(const LogMessage &message, DeferredDecodeFn decoder,
+                                       std::span<const std::byte> arguments) const;
+    void WriteBacktrace(LogLevel sinkLevel) const;
+    void LogTimerSummary(LogLevel level, std::string_view name, const LatencySummary &summary) const;
+    void LogHealth(LogLevel level, const LoggerStats &previous, const LoggerStats &current,
+                   std::chrono::steady_clock::duration interval) const;
+
+    void Dispatch(const LogMessage &message) const;
+    void DispatchRepeated(const LogCallSiteInfo &site, uint64_t repeated,
+                          std::chrono::steady_clock::time_point time) const;
+    // Logs the repeats every AE_LOG_DEDUP site has left out since it last logged
+    void WriteDeduplicatedRepeats();
+    void DispatchDeferred(const LogMessage &message, DeferredDecodeFn decoder,
+                          std::span<const std::byte> arguments) const;
+    // One site per location, level and format. Without keepFormat the site has an empty format and covers every
+    // format logged from the location at the level.
+    const LogCallSiteInfo &InternCallSite(LogLevel level, std::source_location loc, std::string_view fmt,
+                                          bool keepFormat = true) const;
+    void DispatchNewline(LogNewlineKind kind) const;
+    // The queue to push to, null while logging is synchronous and on the backend thread, which writes its own messages
+    // instead of waiting for itself. Only call inside a read section of the sink registry, see Close.
+    [[nodiscard]] AsyncLogQueue *GetAsyncQueue() const;
+    template <class Writer> void Enqueue(AsyncLogQueue &queue, Writer &&write, AsyncOverflowPolicy policy) const;
+    void EnqueueFlush(AsyncLogQueue &queue, uint64_t ticket) const;
+    void WakeAsyncWorker() const;
+    inline void WriteToSinks(const LogMessage &message) const
+    {
+        WriteToSinks(message, message.level);
+    }
+
+    // Writes to the sinks taking sinkLevel, which is the level of the message except for a backtrace
+    void WriteToSinks(const LogMessage &message, LogLevel sinkLevel) const;
+    void WriteNewline(LogNewlineKind kind) const;
+    void RunAsyncWorker();
+    void FlushStreams(bool force = true) const;
+    // Runs FlushStreams(false) in the background every half interval, keeping the shortest interval asked for
+    void ScheduleSinkFlush(std::chrono::milliseconds interval);
+    [[nodiscard]] bool HasSink(const std::string &name) const;
+    void RegisterSink(std::shared_ptr<LogSinkState> state, LogLevel minLevel, LogLevel maxLevel);
+
+    void PrintOpenMessage(const LogSinkState &state) const;
+    void PrintCloseMessage(const LogSinkState &state) const;
+    void PrintTerminationMessage(const LogSinkState &state) const;
+    // Called by the crash handler, see LogSinkState::WriteCrashMarker
+    void WriteCrashMarker(std::string_view marker) const;
 
   private:
-    std::unordered_map<std::string, LogSink> m_Sinks;
-    std::unordered_map<std::string, FILE *> m_Streams;
-    std::unordered_map<std::string, FILE *> m_FileStreams;
     std::string m_OpenMessage;
 
     std::chrono::steady_clock::time_point m_StartPoint;
     std::string m_StartDate;
     std::string m_StartTime;
     Timer m_ExecutionTimer;
+
+    std::atomic<AsyncLogQueue *> m_AsyncQueue;
+    std::unique_ptr<AsyncLogQueue> m_AsyncQueueStorage;
+    AsyncOverflowPolicy m_AsyncPolicy;
+    std::thread m_AsyncWorker;
+    std::atomic<bool> m_AsyncStopRequested;
+    mutable std::atomic<bool> m_AsyncWorkerParked; // Set while the backend waits for messages
+    std::atomic<bool> m_DeferredFormatting;
+    mutable std::atomic<uint64_t> m_AsyncDropped;
+    mutable std::atomic<uint64_t> m_FlushRequested;
+    std::atomic<uint64_t> m_FlushCompleted;
+    // Sinks are published as immutable snapshots, see SinkRegistry
+    std::atomic<uint8_t> m_EnabledLevels;
+    std::atomic<uint8_t> m_TextLevels;   // Levels taken by sinks that need the formatted text
+    std::atomic<uint8_t> m_BinaryLevels; // Levels taken by sinks that store the raw arguments
+    std::unique_ptr<SinkRegistry> m_SinkRegistry;
+
+    // Load shedding, times are steady clock nanoseconds
+    std::atomic<int64_t> m_ShedBudget; // 0 while load shedding is disabled
+    std::atomic<int64_t> m_ShedRecovery;
+    std::atomic<uint8_t> m_ShedMaxLevels;
+    mutable std::atomic<uint8_t> m_ShedLevels;       // Levels below this are dropped
+    mutable std::atomic<int64_t> m_ShedPressureTime; // Last time the slowest sink was over budget
+    mutable std::atomic<int64_t> m_ShedChangeTime;
+    mutable std::atomic<uint64_t> m_ShedMessages;
+    mutable std::atomic<uint64_t> m_ShedMessagesAtStart;
+
+    // Backtrace, the levels are the ones below the trigger level and 0 while it is disabled
+    std::atomic<size_t> m_BacktraceCapacity;
+    std::atomic<uint8_t> m_BacktraceLevels;
+
+    std::atomic<bool> m_SinkLatencyStats;
+    std::unique_ptr<StatsReporter> m_StatsReporter;
+    std::mutex m_SinkFlushMutex;
+    std::chrono::milliseconds m_SinkFlushInterval; // Zero while no sink asked for a timed flush
+
+    std::mutex m_DeduplicatorMutex;
+    std::vector<std::unique_ptr<LogDeduplicator>> m_Deduplicators;
+
+    mutable std::mutex m_CallSiteMutex; // Only taken by a thread's first call from a site, see InternCallSite
+    mutable std::unordered_map<uint64_t, LogCallSiteInfo> m_InternedCallSites;
 };
 
 class Console
@@ -237,6 +1629,13 @@ class Console
 
     void SetColor(LogLevel level);
 
+    // Returns true if stream is a terminal that understands escape sequences, turning them on first for Windows
+    // consoles. Pipes and files return false.
+    [[nodiscard]] static bool EnableEscapeCodes(FILE *stream);
+    // The colors of SetColor as escape sequences to write in front of a line
+    [[nodiscard]] static std::string_view GetEscapeCode(LogLevel level);
+    [[nodiscard]] static std::string_view GetResetCode();
+
   private:
     void Update() const;
 
@@ -248,6 +1647,9 @@ class Console
 #endif
     ConsoleColorCode m_ForegroundColor;
     ConsoleColorCode m_BackgroundColor;
+#ifndef AE_WINDOWS
+    bool m_IsTerminal; // Looked up once, stdout does not change between a terminal and a pipe while running
+#endif // AE_WINDOWS
 };
 
 #define AE_TRACE ae::LogLevel::TRACE
@@ -256,19 +1658,105 @@ class Console
 #define AE_ERROR ae::LogLevel::ERROR
 #define AE_FATAL ae::LogLevel::FATAL
 
+// Every expansion owns a call-site descriptor and a call-site record, when no sink accepts the level the arguments
+// are never evaluated. With a constant level and a string literal format the descriptor is built at compile time,
+// other calls fall back to the call site interned by Logger::Log.
+#define AE_LOG_IMPL(lv, fmt, ...)                                                                                      \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        const ae::LogLevel ae_logLevel = lv;                                                                           \
+        static const ae::LogCallSiteInfo ae_logCallSiteInfo =                                                          \
+            ae::MakeLogCallSiteInfo(ae_logLevel, std::source_location::current(), ae::GetLogFormat(fmt));              \
+        static ae::LogCallSite ae_logCallSite;                                                                         \
+        if (ae_logCallSite.IsEnabled(ae_logLevel))                                                                     \
+        {                                                                                                              \
+            if (ae::IsLogCallSiteOf(ae_logCallSiteInfo, ae_logLevel, ae::GetLogFormat(fmt)))                           \
+            {                                                                                                          \
+                ae::Logger::Get().Log(ae_logCallSiteInfo, fmt __VA_OPT__(, ) __VA_ARGS__);                             \
+            }                                                                                                          \
+            else                                                                                                       \
+            {                                                                                                          \
+                ae::Logger::Get().Log(ae_logLevel, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__);   \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (false)
+
+// Like AE_LOG_IMPL with a plain message followed by alternating keys and values, see Logger::LogFields. The message
+// has to stay valid for the life of the program, as a string literal does.
+#define AE_LOG_KV_IMPL(lv, msg, ...)                                                                                   \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        const ae::LogLevel ae_logLevel = lv;                                                                           \
+        static const ae::LogCallSiteInfo ae_logCallSiteInfo =                                                          \
+            ae::MakeLogCallSiteInfo(ae_logLevel, std::source_location::current(), ae::GetLogFormat(msg));              \
+        static ae::LogCallSite ae_logCallSite;                                                                         \
+        if (ae_logCallSite.IsEnabled(ae_logLevel))                                                                     \
+        {                                                                                                              \
+            if (ae::IsLogCallSiteOf(ae_logCallSiteInfo, ae_logLevel, ae::GetLogFormat(msg)))                           \
+            {                                                                                                          \
+                ae::Logger::Get().LogFields(ae_logCallSiteInfo __VA_OPT__(, ) __VA_ARGS__);                            \
+            }                                                                                                          \
+            else                                                                                                       \
+            {                                                                                                          \
+                ae::Logger::Get().LogFields(ae_logLevel, std::source_location::current(),                              \
+                                            msg __VA_OPT__(, ) __VA_ARGS__);                                           \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (false)
+
+// Like AE_LOG_IMPL but only logs if the sampler agrees, condition is a call on ae_logSampler
+#define AE_LOG_SAMPLED_IMPL(lv, condition, fmt, ...)                                                                   \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        const ae::LogLevel ae_logLevel = lv;                                                                           \
+        static const ae::LogCallSiteInfo ae_logCallSiteInfo =                                                          \
+            ae::MakeLogCallSiteInfo(ae_logLevel, std::source_location::current(), ae::GetLogFormat(fmt));              \
+        static ae::LogCallSite ae_logCallSite;                                                                         \
+        static ae::LogSampler ae_logSampler;                                                                           \
+        if (ae_logCallSite.IsEnabled(ae_logLevel) && ae_logSampler.condition)                                          \
+        {                                                                                                              \
+            if (ae::IsLogCallSiteOf(ae_logCallSiteInfo, ae_logLevel, ae::GetLogFormat(fmt)))                           \
+            {                                                                                                          \
+                ae::Logger::Get().Log(ae_logCallSiteInfo, fmt __VA_OPT__(, ) __VA_ARGS__);                             \
+            }                                                                                                          \
+            else                                                                                                       \
+            {                                                                                                          \
+                ae::Logger::Get().Log(ae_logLevel, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__);   \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (false)
+
+// A call that can not use the descriptor is logged without deduplication, the sampler holds one site's history
+#define AE_LOG_DEDUP_IMPL(lv, fmt, ...)                                                                                \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        const ae::LogLevel ae_logLevel = lv;                                                                           \
+        static const ae::LogCallSiteInfo ae_logCallSiteInfo =                                                          \
+            ae::MakeLogCallSiteInfo(ae_logLevel, std::source_location::current(), ae::GetLogFormat(fmt));              \
+        static ae::LogCallSite ae_logCallSite;                                                                         \
+        static ae::LogDeduplicator &ae_logDeduplicator = ae::Logger::Get().AddDeduplicator();                          \
+        if (ae_logCallSite.IsEnabled(ae_logLevel))                                                                     \
+        {                                                                                                              \
+            if (ae::IsLogCallSiteOf(ae_logCallSiteInfo, ae_logLevel, ae::GetLogFormat(fmt)))                           \
+            {                                                                                                          \
+                ae::Logger::Get().LogDeduplicated(ae_logCallSiteInfo, ae_logDeduplicator,                              \
+                                                  fmt __VA_OPT__(, ) __VA_ARGS__);                                     \
+            }                                                                                                          \
+            else                                                                                                       \
+            {                                                                                                          \
+                ae::Logger::Get().Log(ae_logLevel, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__);   \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (false)
+
 #ifdef AE_DEBUG
 
-#define AE_LOG(lv, fmt, ...) ae::Logger::Get().Log(lv, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_TRACE(fmt, ...)                                                                                         \
-    ae::Logger::Get().Log(ae::LogLevel::TRACE, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_INFO(fmt, ...)                                                                                          \
-    ae::Logger::Get().Log(ae::LogLevel::INFO, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_WARNING(fmt, ...)                                                                                       \
-    ae::Logger::Get().Log(ae::LogLevel::WARNING, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_ERROR(fmt, ...)                                                                                         \
-    ae::Logger::Get().Log(ae::LogLevel::ERROR, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_FATAL(fmt, ...)                                                                                         \
-    ae::Logger::Get().Log(ae::LogLevel::FATAL, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG(lv, fmt, ...) AE_LOG_IMPL(lv, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_TRACE(fmt, ...) AE_LOG_IMPL(ae::LogLevel::TRACE, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_INFO(fmt, ...) AE_LOG_IMPL(ae::LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_WARNING(fmt, ...) AE_LOG_IMPL(ae::LogLevel::WARNING, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_ERROR(fmt, ...) AE_LOG_IMPL(ae::LogLevel::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_FATAL(fmt, ...) AE_LOG_IMPL(ae::LogLevel::FATAL, fmt __VA_OPT__(, ) __VA_ARGS__)
 
 #define AE_LOG_RELEASE(lv, fmt, ...)
 #define AE_LOG_RELEASE_TRACE(fmt, ...)
@@ -277,18 +1765,38 @@ class Console
 #define AE_LOG_RELEASE_ERROR(fmt, ...)
 #define AE_LOG_RELEASE_FATAL(fmt, ...)
 
-#define AE_LOG_BOTH(lv, fmt, ...)                                                                                      \
-    ae::Logger::Get().Log(lv, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_TRACE(fmt, ...)                                                                                    \
-    ae::Logger::Get().Log(ae::LogLevel::TRACE, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_INFO(fmt, ...)                                                                                     \
-    ae::Logger::Get().Log(ae::LogLevel::INFO, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_WARNING(fmt, ...)                                                                                  \
-    ae::Logger::Get().Log(ae::LogLevel::WARNING, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_ERROR(fmt, ...)                                                                                    \
-    ae::Logger::Get().Log(ae::LogLevel::ERROR, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_FATAL(fmt, ...)                                                                                    \
-    ae::Logger::Get().Log(ae::LogLevel::FATAL, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH(lv, fmt, ...) AE_LOG_IMPL(lv, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_TRACE(fmt, ...) AE_LOG_IMPL(ae::LogLevel::TRACE, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_INFO(fmt, ...) AE_LOG_IMPL(ae::LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_WARNING(fmt, ...) AE_LOG_IMPL(ae::LogLevel::WARNING, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_ERROR(fmt, ...) AE_LOG_IMPL(ae::LogLevel::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_FATAL(fmt, ...) AE_LOG_IMPL(ae::LogLevel::FATAL, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define AE_LOG_EVERY_N(lv, n, fmt, ...) AE_LOG_SAMPLED_IMPL(lv, EveryN(n), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_ONCE(lv, fmt, ...) AE_LOG_SAMPLED_IMPL(lv, Once(), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_EVERY_MS(lv, ms, fmt, ...)                                                                              \
+    AE_LOG_SAMPLED_IMPL(lv, EveryInterval(std::chrono::milliseconds(ms)), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RATE_LIMITED(lv, perSecond, fmt, ...)                                                                   \
+    AE_LOG_SAMPLED_IMPL(lv, RateLimited(perSecond), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_DEDUP(lv, fmt, ...) AE_LOG_DEDUP_IMPL(lv, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define AE_LOG_RELEASE_EVERY_N(lv, n, fmt, ...)
+#define AE_LOG_RELEASE_ONCE(lv, fmt, ...)
+#define AE_LOG_RELEASE_EVERY_MS(lv, ms, fmt, ...)
+#define AE_LOG_RELEASE_RATE_LIMITED(lv, perSecond, fmt, ...)
+#define AE_LOG_RELEASE_DEDUP(lv, fmt, ...)
+
+#define AE_LOG_BOTH_EVERY_N(lv, n, fmt, ...) AE_LOG_SAMPLED_IMPL(lv, EveryN(n), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_ONCE(lv, fmt, ...) AE_LOG_SAMPLED_IMPL(lv, Once(), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_EVERY_MS(lv, ms, fmt, ...)                                                                         \
+    AE_LOG_SAMPLED_IMPL(lv, EveryInterval(std::chrono::milliseconds(ms)), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_RATE_LIMITED(lv, perSecond, fmt, ...)                                                              \
+    AE_LOG_SAMPLED_IMPL(lv, RateLimited(perSecond), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_DEDUP(lv, fmt, ...) AE_LOG_DEDUP_IMPL(lv, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define AE_LOG_KV(lv, msg, ...) AE_LOG_KV_IMPL(lv, msg __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_KV(lv, msg, ...)
+#define AE_LOG_BOTH_KV(lv, msg, ...) AE_LOG_KV_IMPL(lv, msg __VA_OPT__(, ) __VA_ARGS__)
 
 #define AE_LOG_NEWLINE_BOTH() ae::Logger::Get().Newline()
 #define AE_LOG_NEWLINE_BOTH_CONSOLE() ae::Logger::Get().NewlineConsole()
@@ -310,31 +1818,45 @@ class Console
 #define AE_LOG_ERROR(fmt, ...)
 #define AE_LOG_FATAL(fmt, ...)
 
-#define AE_LOG_RELEASE(lv, fmt, ...)                                                                                   \
-    ae::Logger::Get().Log(lv, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_RELEASE_TRACE(fmt, ...)                                                                                 \
-    ae::Logger::Get().Log(ae::LogLevel::TRACE, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_RELEASE_INFO(fmt, ...)                                                                                  \
-    ae::Logger::Get().Log(ae::LogLevel::INFO, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_RELEASE_WARNING(fmt, ...)                                                                               \
-    ae::Logger::Get().Log(ae::LogLevel::WARNING, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_RELEASE_ERROR(fmt, ...)                                                                                 \
-    ae::Logger::Get().Log(ae::LogLevel::ERROR, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_RELEASE_FATAL(fmt, ...)                                                                                 \
-    ae::Logger::Get().Log(ae::LogLevel::FATAL, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-
-#define AE_LOG_BOTH(lv, fmt, ...)                                                                                      \
-    ae::Logger::Get().Log(lv, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_TRACE(fmt, ...)                                                                                    \
-    ae::Logger::Get().Log(ae::LogLevel::TRACE, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_INFO(fmt, ...)                                                                                     \
-    ae::Logger::Get().Log(ae::LogLevel::INFO, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_WARNING(fmt, ...)                                                                                  \
-    ae::Logger::Get().Log(ae::LogLevel::WARNING, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_ERROR(fmt, ...)                                                                                    \
-    ae::Logger::Get().Log(ae::LogLevel::ERROR, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define AE_LOG_BOTH_FATAL(fmt, ...)                                                                                    \
-    ae::Logger::Get().Log(ae::LogLevel::FATAL, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE(lv, fmt, ...) AE_LOG_IMPL(lv, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_TRACE(fmt, ...) AE_LOG_IMPL(ae::LogLevel::TRACE, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_INFO(fmt, ...) AE_LOG_IMPL(ae::LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_WARNING(fmt, ...) AE_LOG_IMPL(ae::LogLevel::WARNING, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_ERROR(fmt, ...) AE_LOG_IMPL(ae::LogLevel::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_FATAL(fmt, ...) AE_LOG_IMPL(ae::LogLevel::FATAL, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define AE_LOG_BOTH(lv, fmt, ...) AE_LOG_IMPL(lv, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_TRACE(fmt, ...) AE_LOG_IMPL(ae::LogLevel::TRACE, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_INFO(fmt, ...) AE_LOG_IMPL(ae::LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_WARNING(fmt, ...) AE_LOG_IMPL(ae::LogLevel::WARNING, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_ERROR(fmt, ...) AE_LOG_IMPL(ae::LogLevel::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_FATAL(fmt, ...) AE_LOG_IMPL(ae::LogLevel::FATAL, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define AE_LOG_EVERY_N(lv, n, fmt, ...)
+#define AE_LOG_ONCE(lv, fmt, ...)
+#define AE_LOG_EVERY_MS(lv, ms, fmt, ...)
+#define AE_LOG_RATE_LIMITED(lv, perSecond, fmt, ...)
+#define AE_LOG_DEDUP(lv, fmt, ...)
+
+#define AE_LOG_RELEASE_EVERY_N(lv, n, fmt, ...) AE_LOG_SAMPLED_IMPL(lv, EveryN(n), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_ONCE(lv, fmt, ...) AE_LOG_SAMPLED_IMPL(lv, Once(), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_EVERY_MS(lv, ms, fmt, ...)                                                                      \
+    AE_LOG_SAMPLED_IMPL(lv, EveryInterval(std::chrono::milliseconds(ms)), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_RATE_LIMITED(lv, perSecond, fmt, ...)                                                           \
+    AE_LOG_SAMPLED_IMPL(lv, RateLimited(perSecond), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_RELEASE_DEDUP(lv, fmt, ...) AE_LOG_DEDUP_IMPL(lv, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define AE_LOG_BOTH_EVERY_N(lv, n, fmt, ...) AE_LOG_SAMPLED_IMPL(lv, EveryN(n), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_ONCE(lv, fmt, ...) AE_LOG_SAMPLED_IMPL(lv, Once(), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_EVERY_MS(lv, ms, fmt, ...)                                                                         \
+    AE_LOG_SAMPLED_IMPL(lv, EveryInterval(std::chrono::milliseconds(ms)), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_RATE_LIMITED(lv, perSecond, fmt, ...)                                                              \
+    AE_LOG_SAMPLED_IMPL(lv, RateLimited(perSecond), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_DEDUP(lv, fmt, ...) AE_LOG_DEDUP_IMPL(lv, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define AE_LOG_KV(lv, msg, ...)
+#define AE_LOG_RELEASE_KV(lv, msg, ...) AE_LOG_KV_IMPL(lv, msg __VA_OPT__(, ) __VA_ARGS__)
+#define AE_LOG_BOTH_KV(lv, msg, ...) AE_LOG_KV_IMPL(lv, msg __VA_OPT__(, ) __VA_ARGS__)
 
 #define AE_LOG_NEWLINE_BOTH() ae::Logger::Get().Newline()
 #define AE_LOG_NEWLINE_BOTH_CONSOLE() ae::Logger::Get().NewlineConsole()
@@ -372,6 +1894,28 @@ class Console
 #define AE_LOG_BOTH_ERROR(fmt, ...)
 #define AE_LOG_BOTH_FATAL(fmt, ...)
 
+#define AE_LOG_EVERY_N(lv, n, fmt, ...)
+#define AE_LOG_ONCE(lv, fmt, ...)
+#define AE_LOG_EVERY_MS(lv, ms, fmt, ...)
+#define AE_LOG_RATE_LIMITED(lv, perSecond, fmt, ...)
+#define AE_LOG_DEDUP(lv, fmt, ...)
+
+#define AE_LOG_RELEASE_EVERY_N(lv, n, fmt, ...)
+#define AE_LOG_RELEASE_ONCE(lv, fmt, ...)
+#define AE_LOG_RELEASE_EVERY_MS(lv, ms, fmt, ...)
+#define AE_LOG_RELEASE_RATE_LIMITED(lv, perSecond, fmt, ...)
+#define AE_LOG_RELEASE_DEDUP(lv, fmt, ...)
+
+#define AE_LOG_BOTH_EVERY_N(lv, n, fmt, ...)
+#define AE_LOG_BOTH_ONCE(lv, fmt, ...)
+#define AE_LOG_BOTH_EVERY_MS(lv, ms, fmt, ...)
+#define AE_LOG_BOTH_RATE_LIMITED(lv, perSecond, fmt, ...)
+#define AE_LOG_BOTH_DEDUP(lv, fmt, ...)
+
+#define AE_LOG_KV(lv, msg, ...)
+#define AE_LOG_RELEASE_KV(lv, msg, ...)
+#define AE_LOG_BOTH_KV(lv, msg, ...)
+
 #define AE_LOG_NEWLINE_BOTH()
 #define AE_LOG_NEWLINE_BOTH_CONSOLE()
 #define AE_LOG_NEWLINE_BOTH_FILE()
@@ -391,11 +1935,33 @@ class Console
 #define AE_LOG_DEBUG_WARNING AE_LOG_WARNING
 #define AE_LOG_DEBUG_ERROR AE_LOG_ERROR
 #define AE_LOG_DEBUG_FATAL AE_LOG_FATAL
+#define AE_LOG_DEBUG_KV AE_LOG_KV
+#define AE_LOG_DEBUG_EVERY_N AE_LOG_EVERY_N
+#define AE_LOG_DEBUG_ONCE AE_LOG_ONCE
+#define AE_LOG_DEBUG_EVERY_MS AE_LOG_EVERY_MS
+#define AE_LOG_DEBUG_RATE_LIMITED AE_LOG_RATE_LIMITED
+#define AE_LOG_DEBUG_DEDUP AE_LOG_DEDUP
 
 #define AE_LOG_NEWLINE_DEBUG AE_LOG_NEWLINE
 #define AE_LOG_NEWLINE_DEBUG_CONSOLE AE_LOG_NEWLINE_CONSOLE
 #define AE_LOG_NEWLINE_DEBUG_FILE AE_LOG_NEWLINE_FILE
 
+#define AE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define AE_PROFILE_CONCAT(a, b) AE_PROFILE_CONCAT_IMPL(a, b)
+
+// Profiles the rest of the enclosing scope as a zone called name, see ae::Profiler. Kept in every configuration.
+#define AE_PROFILE_SCOPE(name)                                                                                         \
+    static constexpr ae::ProfileZoneInfo AE_PROFILE_CONCAT(ae_profileZoneInfo, __LINE__) =                             \
+        ae::MakeProfileZoneInfo(name, std::source_location::current());                                                \
+    ae::ProfileScope AE_PROFILE_CONCAT(ae_profileScope, __LINE__)(AE_PROFILE_CONCAT(ae_profileZoneInfo, __LINE__))
+
+#define AE_PROFILE_FUNCTION() AE_PROFILE_SCOPE(std::source_location::current().function_name())
+
+// Records the duration of the rest of the enclosing scope into the ae::TimerStats called name
+#define AE_TIMER_STATS_SCOPE(name)                                                                                     \
+    static ae::TimerStats &AE_PROFILE_CONCAT(ae_timerStats, __LINE__) = ae::TimerStats::Get(name);                     \
+    ae::TimerStatsScope AE_PROFILE_CONCAT(ae_timerStatsScope, __LINE__)(AE_PROFILE_CONCAT(ae_timerStats, __LINE__))
+
 // Exceptions
 // ---------------------------------------------------------------------------------------------------------------------------------------
 
@@ -433,218 +1999,151 @@ inline std::string FormatError(std::string type, std::source_location loc, std::
     return message;
 }
 
-class LogicError : public std::logic_error
+// Arguments an exception copies when thrown and formats on the first call to what(). The text is usually read in a
+// catch handler after the throwing frame is gone, so only numbers and strings, which are copied, qualify.
+template <class T>
+concept LazyErrorArg = DeferredString<T> || std::is_arithmetic_v<std::remove_cvref_t<T>>;
+
+// The text of an exception, built on the first call to Get. Messages whose arguments are all LazyErrorArg only copy
+// them when the exception is thrown, others are formatted right away. Copies of the exception share the text.
+class ErrorMessage
 {
   public:
     template <class... Args>
-    explicit LogicError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::logic_error(FormatError("Logic error", loc, fmt, std::forward<Args>(args)...))
+    ErrorMessage(const char *type, std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
+        : m_State(std::make_shared<State>(type, loc, fmt.get()))
     {
+        if constexpr ((LazyErrorArg<Args> && ...))
+        {
+            (EncodeDeferredArg(m_State->arguments, args), ...);
+            m_State->decoder = &DecodeDeferred<Args...>;
+        }
+
+        else
+        {
+            std::format_to(std::back_inserter(m_State->content), fmt, std::forward<Args>(args)...);
+        }
     }
 
-    explicit LogicError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::logic_error(FormatError("Logic error", loc, fmt, args))
+    // The arguments only live as long as the call, so they are formatted right away
+    ErrorMessage(const char *type, std::source_location loc, std::string_view fmt, std::format_args args);
+
+    // Safe to call from several threads at once
+    [[nodiscard]] const char *Get() const noexcept;
+
+  private:
+    struct State
     {
-    }
-};
+        State(const char *type, std::source_location loc, std::string_view fmt) : type(type), loc(loc), fmt(fmt)
+        {
+        }
 
-#define AE_THROW_LOGIC_ERROR(fmt, ...)                                                                                 \
-    throw ae::LogicError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
+        const char *type;
+        std::source_location loc;
+        std::string_view fmt; // Points at the format string literal of the throw
+        std::vector<std::byte> arguments;
+        DeferredDecodeFn decoder = nullptr;
+        std::string content;
+        std::once_flag built;
+        std::string message;
+        const char *text = nullptr;
+    };
+
+    std::shared_ptr<State> m_State;
+};
 
-class InvalidArgument : public std::invalid_argument
+// The name an exception type writes into its message, as a template argument of LazyError
+template <size_t N> struct LazyErrorType
 {
-  public:
-    template <class... Args>
-    explicit InvalidArgument(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::invalid_argument(FormatError("Invalid error", loc, fmt, std::forward<Args>(args)...))
+    constexpr LazyErrorType(const char (&text)[N])
     {
+        std::copy_n(text, N, value);
     }
 
-    explicit InvalidArgument(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::invalid_argument(FormatError("Invalid error", loc, fmt, args))
-    {
-    }
+    char value[N]{};
 };
 
-#define AE_THROW_INVALID_ARGUMENT(fmt, ...)                                                                            \
-    throw ae::InvalidArgument(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-
-class MathError : public std::domain_error
+// An exception of type Base whose what() is the ErrorMessage of the throw. Each Type names a distinct exception, so
+// errors sharing a standard base can still be caught apart.
+template <class Base, LazyErrorType Type> class LazyError : public Base
 {
   public:
     template <class... Args>
-    explicit MathError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::domain_error(FormatError("Math error", loc, fmt, std::forward<Args>(args)...))
+    explicit LazyError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
+        : Base(Type.value), m_Message(Type.value, loc, fmt, std::forward<Args>(args)...)
     {
     }
 
-    explicit MathError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::domain_error(FormatError("Math error", loc, fmt, args))
+    explicit LazyError(std::source_location loc, std::string_view fmt, std::format_args args)
+        : Base(Type.value), m_Message(Type.value, loc, fmt, args)
     {
     }
-};
-
-#define AE_THROW_MATH_ERROR(fmt, ...)                                                                                  \
-    throw ae::MathError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class LengthError : public std::length_error
-{
-  public:
-    template <class... Args>
-    explicit LengthError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::length_error(FormatError("Length error", loc, fmt, std::forward<Args>(args)...))
+    [[nodiscard]] const char *what() const noexcept override
     {
+        return m_Message.Get();
     }
 
-    explicit LengthError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::length_error(FormatError("Length error", loc, fmt, args))
-    {
-    }
+  private:
+    ErrorMessage m_Message;
 };
 
+using LogicError = LazyError<std::logic_error, "Logic error">;
+
+#define AE_THROW_LOGIC_ERROR(fmt, ...)                                                                                 \
+    throw ae::LogicError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
+
+using InvalidArgument = LazyError<std::invalid_argument, "Invalid error">;
+
+#define AE_THROW_INVALID_ARGUMENT(fmt, ...)                                                                            \
+    throw ae::InvalidArgument(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
+
+using MathError = LazyError<std::domain_error, "Math error">;
+
+#define AE_THROW_MATH_ERROR(fmt, ...)                                                                                  \
+    throw ae::MathError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
+
+using LengthError = LazyError<std::length_error, "Length error">;
+
 #define AE_THROW_LENGTH_ERROR(fmt, ...)                                                                                \
     throw ae::LengthError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class OutOfRangeError : public std::out_of_range
-{
-  public:
-    template <class... Args>
-    explicit OutOfRangeError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::out_of_range(FormatError("Out of range error", loc, fmt, std::forward<Args>(args)...))
-    {
-    }
-
-    explicit OutOfRangeError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::out_of_range(FormatError("Out of range error", loc, fmt, args))
-    {
-    }
-};
+using OutOfRangeError = LazyError<std::out_of_range, "Out of range error">;
 
 #define AE_THROW_OUT_OF_RANGE_ERROR(fmt, ...)                                                                          \
     throw ae::OutOfRangeError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class RuntimeError : public std::runtime_error
-{
-  public:
-    template <class... Args>
-    explicit RuntimeError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::runtime_error(FormatError("Runtime error", loc, fmt, std::forward<Args>(args)...))
-    {
-    }
-
-    explicit RuntimeError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::runtime_error(FormatError("Runtime error", loc, fmt, args))
-    {
-    }
-};
+using RuntimeError = LazyError<std::runtime_error, "Runtime error">;
 
 #define AE_THROW_RUNTIME_ERROR(fmt, ...)                                                                               \
     throw ae::RuntimeError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class RangeError : public std::range_error
-{
-  public:
-    template <class... Args>
-    explicit RangeError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::range_error(FormatError("Range error", loc, fmt, std::forward<Args>(args)...))
-    {
-    }
-
-    explicit RangeError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::range_error(FormatError("Range error", loc, fmt, args))
-    {
-    }
-};
+using RangeError = LazyError<std::range_error, "Range error">;
 
 #define AE_THROW_RANGE_ERROR(fmt, ...)                                                                                 \
     throw ae::RangeError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class OverflowError : public std::overflow_error
-{
-  public:
-    template <class... Args>
-    explicit OverflowError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::overflow_error(FormatError("Overflow error", loc, fmt, std::forward<Args>(args)...))
-    {
-    }
-
-    explicit OverflowError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::overflow_error(FormatError("Overflow error", loc, fmt, args))
-    {
-    }
-};
+using OverflowError = LazyError<std::overflow_error, "Overflow error">;
 
 #define AE_THROW_OVERFLOW_ERROR(fmt, ...)                                                                              \
     throw ae::OverflowError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class UnderflowError : public std::underflow_error
-{
-  public:
-    template <class... Args>
-    explicit UnderflowError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::underflow_error(FormatError("Underflow error", loc, fmt, std::forward<Args>(args)...))
-    {
-    }
-
-    explicit UnderflowError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::underflow_error(FormatError("Underflow error", loc, fmt, args))
-    {
-    }
-};
+using UnderflowError = LazyError<std::underflow_error, "Underflow error">;
 
 #define AE_THROW_UNDERFLOW_ERROR(fmt, ...)                                                                             \
     throw ae::UnderflowError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class FileNotFoundError : public std::runtime_error
-{
-  public:
-    template <class... Args>
-    explicit FileNotFoundError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::runtime_error(FormatError("File not found error", loc, fmt, std::forward<Args>(args)...))
-    {
-    }
-
-    explicit FileNotFoundError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::runtime_error(FormatError("File not found error", loc, fmt, args))
-    {
-    }
-};
+using FileNotFoundError = LazyError<std::runtime_error, "File not found error">;
 
 #define AE_THROW_FILE_NOT_FOUND_ERROR(fmt, ...)                                                                        \
     throw ae::FileNotFoundError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class FilesystemError : public std::runtime_error
-{
-  public:
-    template <class... Args>
-    explicit FilesystemError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::runtime_error(FormatError("Filesystem error", loc, fmt, std::forward<Args>(args)...))
-    {
-    }
-
-    explicit FilesystemError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::runtime_error(FormatError("Filesystem error", loc, fmt, args))
-    {
-    }
-};
+using FilesystemError = LazyError<std::runtime_error, "Filesystem error">;
 
 #define AE_THROW_FILESYSTEM_ERROR(fmt, ...)                                                                            \
     throw ae::FilesystemError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
 
-class FileOpenError : public std::runtime_error
-{
-  public:
-    template <class... Args>
-    explicit FileOpenError(std::source_location loc, std::format_string<Args...> fmt, Args &&...args)
-        : std::runtime_error(FormatError("File open error", loc, fmt, std::forward<Args>(args)...))
-    {
-    }
-
-    explicit FileOpenError(std::source_location loc, std::string_view fmt, std::format_args args)
-        : std::runtime_error(FormatError("File open error", loc, fmt, args))
-    {
-    }
-};
+using FileOpenError = LazyError<std::runtime_error, "File open error">;
 
 #define AE_THROW_FILE_OPEN_ERROR(fmt, ...)                                                                             \
     throw ae::FileOpenError(std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
@@ -743,6 +2242,10 @@ class DateTime
         return FormatNow("{:%TZ}", ZoneKind::UTC);
     }
 
+    // Local HH:MM:SS.mmm of the given time. The text lives in a per-thread buffer that is valid until the next call on
+    // the same thread, and the HH:MM:SS part is only recomputed when the second changes.
+    [[nodiscard]] static std::string_view LogTimeAsString(std::chrono::system_clock::time_point time);
+
     [[nodiscard]] inline static std::string DateAsString()
     {
         return FormatNow("{:%F}", ZoneKind::LOCAL);
@@ -6,6 +6,11 @@
 #include <cstdint>
 #include <cstdio>
 #include <print>
+#include <string_view>
+
+#ifdef AE_WINDOWS
+#include <io.h>
+#endif // AE_WINDOWS
 
 #ifdef AE_WINDOWS
 
@@ -151,13 +156,25 @@ constexpr std::array<BgAnsiCode, 5> c_BackgroundLookup = {
 
 #endif // AE_WINDOWS
 
+// The colors of the lookups above as escape sequences, background first
+constexpr std::array<std::string_view, 5> c_EscapeLookup = {
+    "\x1b[49;90m", // Trace
+    "\x1b[49;32m", // Info
+    "\x1b[49;93m", // Warn
+    "\x1b[49;31m", // Error
+    "\x1b[41;30m", // Fatal
+};
+
+constexpr std::string_view c_ResetEscape = "\x1b[0m";
+
 ae::Console::Console()
 #ifdef AE_WINDOWS
     : m_ForegroundColor(static_cast<ConsoleColorCode>(g_DefaultFg)),
       m_BackgroundColor(static_cast<ConsoleColorCode>(g_DefaultBg))
 #else
     : m_ForegroundColor(static_cast<ConsoleColorCode>(static_cast<int>(ConsoleForegroundColor::WHITE))),
-      m_BackgroundColor(static_cast<ConsoleColorCode>(static_cast<int>(ConsoleBackgroundColor::DEFAULT)))
+      m_BackgroundColor(static_cast<ConsoleColorCode>(static_cast<int>(ConsoleBackgroundColor::DEFAULT))),
+      m_IsTerminal(isatty(STDOUT_FILENO) != 0)
 #endif
 {
 }
@@ -168,9 +185,9 @@ ae::Console::~Console()
     const HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
     SetConsoleTextAttribute(handle, static_cast<WORD>(g_DefaultAttrs));
 #else
-    if (isatty(STDOUT_FILENO) != 0)
+    if (m_IsTerminal)
     {
-        std::fputs("\x1b[0m", stdout);
+        std::fputs(c_ResetEscape.data(), stdout);
         std::fflush(stdout);
     }
 #endif
@@ -184,7 +201,7 @@ void ae::Console::SetColor(LogLevel level)
     const ColorWord fg = c_ForegroundLookup[idx];
 
     ColorWord bg = g_DefaultBg;
-    if (level == LogLevel::Fatal)
+    if (level == LogLevel::FATAL)
     {
         bg = c_BackgroundLookup[idx]; // red background for fatal
     }
@@ -210,7 +227,7 @@ void ae::Console::Update() const
 
     SetConsoleTextAttribute(handle, static_cast<WORD>(attrs));
 #else
-    if (isatty(STDOUT_FILENO) == 0)
+    if (!m_IsTerminal)
     {
         return;
     }
@@ -222,3 +239,38 @@ void ae::Console::Update() const
     std::fflush(stdout);
 #endif
 }
+
+bool ae::Console::EnableEscapeCodes(FILE *stream)
+{
+#ifdef AE_WINDOWS
+    const int descriptor = _fileno(stream);
+
+    if (descriptor < 0 || _isatty(descriptor) == 0)
+    {
+        return false;
+    }
+
+    const auto handle = reinterpret_cast<HANDLE>(_get_osfhandle(descriptor));
+    DWORD mode = 0;
+
+    if (GetConsoleMode(handle, &mode) == 0)
+    {
+        return false;
+    }
+
+    return SetConsoleMode(handle, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING) != 0;
+#else
+    const int descriptor = fileno(stream);
+    return descriptor >= 0 && isatty(descriptor) != 0;
+#endif // AE_WINDOWS
+}
+
+std::string_view ae::Console::GetEscapeCode(LogLevel level)
+{
+    return c_EscapeLookup[static_cast<size_t>(level)];
+}
+
+std::string_view ae::Console::GetResetCode()
+{
+    return c_ResetEscape;
+}
@@ -1,15 +1,171 @@
 #include "general/pch.h"
 
 #include "Log.h"
+#include "async/AsyncLogQueue.h"
+#include "backtrace/BacktraceRing.h"
+#include "crash/CrashHandler.h"
+#include "sinks/BinaryFileWriter.h"
+#include "sinks/BufferedFileWriter.h"
+#include "sinks/LogLines.h"
+#include "sinks/RingFileWriter.h"
+#include "sinks/RotatingFileWriter.h"
+#include "sinks/SinkRegistry.h"
+#include "sinks/StructuredLines.h"
+#include "sinks/UringFileWriter.h"
+#include "stats/StatsReporter.h"
+#include "stats/ThreadCounters.h"
 
 #include <filesystem>
 #include <print>
+#include <utility>
 
-constexpr static std::array<std::string_view, 5> c_LevelLookup = { "TRACE", "INFO", "WARNING", "ERROR", "FATAL" };
+// Renders a message the way file sinks show it, into a buffer reused by the calling thread
+static std::string_view FormatFileLine(const ae::LogMessage &message, std::string_view time)
+{
+    thread_local std::string line;
+    line.clear();
+
+    ae::AppendFileLine(line, time, message.level, message.site->file, message.site->line, message.message);
+
+    return line;
+}
+
+// Set on the async backend thread, which must write its own messages instead of queueing behind itself
+thread_local bool t_OnAsyncWorker = false;
+
+// Messages of this thread that no sink took, see Logger::EnableBacktrace
+thread_local ae::BacktraceRing t_Backtrace;
+
+// Load shedding drops one more level at most this often
+constexpr int64_t c_ShedStepNanos = 100'000'000;
+
+// Call sites this thread has interned, so only its first call from a site takes the lock, see Logger::InternCallSite
+thread_local std::unordered_map<uint64_t, const ae::LogCallSiteInfo *> t_InternedCallSites;
+
+// What the sink being called has written, see LogSinkStats::bytes
+thread_local uint64_t t_SinkBytes = 0;
+
+// A sink that throws is reported once on stderr, the exception must neither reach the code that logged nor end the
+// async backend. Logging the failure could throw the same way.
+static void ReportSinkFailure(const ae::LogSinkState &state, const char *what) noexcept
+{
+    if (state.failed.exchange(true, std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    try
+    {
+        std::println(stderr, "Log sink '{}' threw an exception, later ones are not reported\nMessage: {}", state.name,
+                     what);
+    }
+
+    catch (...)
+    {
+    }
+}
+
+template <class Call> static void CallSink(const ae::LogSinkState &state, Call &&call) noexcept
+{
+    try
+    {
+        call();
+    }
+
+    catch (const std::exception &e)
+    {
+        ReportSinkFailure(state, e.what());
+    }
+
+    catch (...)
+    {
+        ReportSinkFailure(state, "Unknown exception");
+    }
+}
+
+// Marks the calling thread as writing a message to its sinks, see GetLogNestingDepth. The byte count of the sink that
+// logs is kept aside while the nested message is written.
+struct LogNestingScope
+{
+    uint64_t sinkBytes = t_SinkBytes;
+
+    LogNestingScope()
+    {
+        ++ae::GetLogNestingDepth();
+    }
+
+    ~LogNestingScope()
+    {
+        --ae::GetLogNestingDepth();
+        t_SinkBytes = sinkBytes;
+    }
+
+    LogNestingScope(const LogNestingScope &) = delete;
+    LogNestingScope &operator=(const LogNestingScope &) = delete;
+};
+
+// Called by the sinks of this file for what they write per message
+static void CountSinkBytes(size_t bytes)
+{
+    t_SinkBytes += bytes;
+}
+
+// About three significant digits in the largest unit that keeps the value at or above one
+static void AppendDuration(std::string &out, std::chrono::nanoseconds duration)
+{
+    constexpr std::array<std::pair<double, std::string_view>, 3> units = { {
+        { 1e9, "s" },
+        { 1e6, "ms" },
+        { 1e3, "us" },
+    } };
+
+    const double nanos = static_cast<double>(duration.count());
+
+    for (const auto &[scale, unit] : units)
+    {
+        if (nanos >= scale)
+        {
+            const double value = nanos / scale;
+            const int decimals = value < 10 ? 2 : (value < 100 ? 1 : 0);
+            std::format_to(std::back_inserter(out), "{:.{}f} {}", value, decimals, unit);
+            return;
+        }
+    }
+
+    std::format_to(std::back_inserter(out), "{} ns", duration.count());
+}
+
+static int64_t SteadyNanos()
+{
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+static void CreateParentDirectories(const std::string &name, const std::filesystem::path &path)
+{
+    auto parent = path.parent_path();
+
+    if (!parent.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(parent, ec);
+
+        if (ec)
+        {
+            AE_THROW_FILESYSTEM_ERROR("Failed to create directories for log sink '{}'. Path: '{}'. Error: {}", name,
+                                      path.string(), ec.message());
+        }
+    }
+}
 
 ae::Logger::Logger()
     : m_OpenMessage(c_LogLibVersion), m_StartPoint(DateTime::SteadyNow()), m_StartDate(DateTime::DateAsString()),
-      m_StartTime(DateTime::TimeAsString())
+      m_StartTime(DateTime::TimeAsString()), m_AsyncQueue(nullptr), m_AsyncPolicy(AsyncOverflowPolicy::BLOCK),
+      m_AsyncStopRequested(false), m_AsyncWorkerParked(false), m_DeferredFormatting(false), m_AsyncDropped(0),
+      m_FlushRequested(0), m_FlushCompleted(0), m_EnabledLevels(0), m_TextLevels(0), m_BinaryLevels(0),
+      m_SinkRegistry(std::make_unique<SinkRegistry>(m_EnabledLevels, m_TextLevels, m_BinaryLevels)), m_ShedBudget(0),
+      m_ShedRecovery(0), m_ShedMaxLevels(0), m_ShedLevels(0), m_ShedPressureTime(0), m_ShedChangeTime(0),
+      m_ShedMessages(0), m_ShedMessagesAtStart(0), m_BacktraceCapacity(0), m_BacktraceLevels(0),
+      m_SinkLatencyStats(false), m_StatsReporter(std::make_unique<StatsReporter>()), m_SinkFlushInterval(0)
 {
     m_ExecutionTimer.Start();
 }
@@ -25,6 +181,8 @@ ae::Logger::~Logger() noexcept
     {
         std::fputs("Unknown exception thrown while closing Logger\n", stderr);
     }
+
+    RemoveCrashWriter(this);
 }
 
 void ae::Logger::AddConsoleSink(const std::string &name, LogSinkConsoleKind type, LogLevel minLevel, LogLevel maxLevel)
@@ -34,13 +192,18 @@ void ae::Logger::AddConsoleSink(const std::string &name, LogSinkConsoleKind type
                  "logs from dist builds, making the action redundant");
     return;
 #endif // AE_DIST
+    if (HasSink(name))
+    {
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
+    }
+
     FILE *stream = nullptr;
 
     switch (type)
     {
     case LogSinkConsoleKind::STDOUT:
         stream = stdout;
-        PrintOpenMessage(stream);
         break;
     case LogSinkConsoleKind::STDERR:
         stream = stderr;
@@ -49,30 +212,50 @@ void ae::Logger::AddConsoleSink(const std::string &name, LogSinkConsoleKind type
         stream = stdout;
     };
 
-    m_Streams.insert(std::make_pair(name, stream));
+    // Checked once here instead of for every line, a sink that goes to a pipe or file stays free of escape codes
+    const bool colored = Console::EnableEscapeCodes(stream);
 
-    m_Sinks.insert(std::make_pair(name,
-                                  [stream, minLevel, maxLevel](const LogMessage &message)
-                                  {
-                                      if (message.level >= minLevel && message.level <= maxLevel)
-                                      {
-                                          Console::GetInstance().SetColor(message.level);
-
-                                          if (message.level >= LogLevel::ERROR)
-                                          {
-                                              std::println(stream, "\n{} [{}] {}:{} - {}\n", DateTime::TimeAsString(),
-                                                           c_LevelLookup[static_cast<uint32_t>(message.level)].data(),
-                                                           message.file.data(), message.line, message.message);
-                                          }
-
-                                          else
-                                          {
-                                              std::println(stream, "{} [{}] {}:{} - {}", DateTime::TimeAsString(),
-                                                           c_LevelLookup[static_cast<uint32_t>(message.level)].data(),
-                                                           message.file.data(), message.line, message.message);
-                                          }
-                                      }
-                                  }));
+    LogSink sink = [stream, colored](const LogMessage &message, std::string_view time)
+    {
+        // The whole line including its colors goes out in one write, so lines from different sinks and threads
+        // can not interleave their colors
+        thread_local std::string text;
+        text.clear();
+
+        const bool spaced = message.level >= LogLevel::ERROR;
+
+        if (spaced)
+        {
+            text.push_back('\n');
+        }
+
+        if (colored)
+        {
+            text += Console::GetEscapeCode(message.level);
+        }
+
+        std::format_to(std::back_inserter(text), "{} [{}] {}:{} - {}", time,
+                       c_LevelLookup[static_cast<uint32_t>(message.level)], message.site->file, message.site->line,
+                       message.message);
+
+        if (colored)
+        {
+            text += Console::GetResetCode();
+        }
+
+        text += spaced ? "\n\n" : "\n";
+        std::fwrite(text.data(), 1, text.size(), stream);
+        CountSinkBytes(text.size());
+    };
+
+    auto state = std::make_shared<LogSinkState>(name, false, stream, false, std::move(sink));
+
+    if (type == LogSinkConsoleKind::STDOUT)
+    {
+        PrintOpenMessage(*state);
+    }
+
+    RegisterSink(std::move(state), minLevel, maxLevel);
 }
 
 void ae::Logger::AddFileSink(const std::string &name, const std::string &path, LogLevel minLevel, LogLevel maxLevel)
@@ -82,21 +265,15 @@ void ae::Logger::AddFileSink(const std::string &name, const std::string &path, L
                  "logs from dist builds, making the action redundant");
     return;
 #endif // AE_DIST
-    std::filesystem::path p = path;
-    auto parent = p.parent_path();
-
-    if (!parent.empty())
+    if (HasSink(name))
     {
-        std::error_code ec;
-        std::filesystem::create_directories(parent, ec);
-
-        if (ec)
-        {
-            AE_THROW_FILESYSTEM_ERROR("Failed to create directories for log sink '{}'. Path: '{}'. Error: {}", name,
-                                      path, ec.message());
-        }
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
     }
 
+    std::filesystem::path p = path;
+    CreateParentDirectories(name, p);
+
     FILE *stream = nullptr;
 
 #ifdef AE_WINDOWS
@@ -115,110 +292,1400 @@ void ae::Logger::AddFileSink(const std::string &name, const std::string &path, L
     }
 #endif
 
-    PrintOpenMessage(stream);
+    LogSink sink = [stream](const LogMessage &message, std::string_view time)
+    {
+        const std::string_view line = FormatFileLine(message, time);
+        std::fwrite(line.data(), 1, line.size(), stream);
+        CountSinkBytes(line.size());
+    };
 
-    m_FileStreams.insert(std::make_pair(name, stream));
-    m_Streams.insert(std::make_pair(name, stream));
+    auto state = std::make_shared<LogSinkState>(name, true, stream, true, std::move(sink));
+    PrintOpenMessage(*state);
 
-    m_Sinks.insert(std::make_pair(name,
-                                  [stream, minLevel, maxLevel](const LogMessage &message)
-                                  {
-                                      if (message.level >= minLevel && message.level <= maxLevel)
-                                      {
-                                          std::println(stream, "{} [{}] | {}:{} - {}", DateTime::TimeAsString(),
-                                                       c_LevelLookup[static_cast<uint32_t>(message.level)].data(),
-                                                       message.file.data(), message.line, message.message);
-                                      }
-                                  }));
+    RegisterSink(std::move(state), minLevel, maxLevel);
 }
 
-void ae::Logger::RemoveSink(const std::string &name)
+void ae::Logger::AddFileSink(const std::string &name, const std::string &path, const LogFileRotationOptions &rotation,
+                             LogLevel minLevel, LogLevel maxLevel)
 {
-    auto it = m_Sinks.find(name);
+    if (rotation.maxBytes == 0 && rotation.interval.count() == 0)
+    {
+        AddFileSink(name, path, minLevel, maxLevel);
+        return;
+    }
 
-    if (it != m_Sinks.end())
+#ifdef AE_DIST
+    std::println("WARNING: Attempted to add a file sink to Logger. This was skipped since log system removes all "
+                 "logs from dist builds, making the action redundant");
+    return;
+#endif // AE_DIST
+    if (HasSink(name))
     {
-        auto streamIt = m_Streams.find(name);
-        m_Streams.erase(streamIt);
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
+    }
+
+    std::filesystem::path p = path;
+    CreateParentDirectories(name, p);
 
-        auto fileIt = m_FileStreams.find(name);
+    auto writer = std::make_shared<RotatingFileWriter>(p, rotation);
 
-        if (fileIt != m_FileStreams.end())
+    LogSink sink = [writer](const LogMessage &message, std::string_view time)
+    {
+        const std::string_view line = FormatFileLine(message, time);
+        writer->Write(line);
+        CountSinkBytes(line.size());
+    };
+
+    auto state = std::make_shared<LogSinkState>(name, true, nullptr, false, std::move(sink));
+    state->writeText = [writer](std::string_view text) { writer->Write(text); };
+    state->flush = [writer](bool force)
+    {
+        if (force)
         {
-            m_FileStreams.erase(fileIt);
+            writer->Flush();
         }
+    };
+    state->writeCrashMarker = [writer](std::string_view marker) { writer->WriteCrashMarker(marker); };
+
+    PrintOpenMessage(*state);
+
+    RegisterSink(std::move(state), minLevel, maxLevel);
+}
 
-        m_Sinks.erase(it);
+void ae::Logger::AddBufferedFileSink(const std::string &name, const std::string &path,
+                                     const LogFileBufferOptions &options, LogLevel minLevel, LogLevel maxLevel)
+{
+#ifdef AE_DIST
+    std::println("WARNING: Attempted to add a buffered file sink to Logger. This was skipped since log system removes "
+                 "all logs from dist builds, making the action redundant");
+    return;
+#endif // AE_DIST
+    if (HasSink(name))
+    {
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
     }
 
-    else
+    if (options.bufferSize == 0)
     {
-        AE_LOG_WARNING("Tried to remove sink with name '{}' but it does not exist", name);
+        AE_THROW_INVALID_ARGUMENT("Buffer size of buffered file sink '{}' must be greater than zero", name);
     }
+
+    std::filesystem::path p = path;
+    CreateParentDirectories(name, p);
+
+    // Shared by the hooks below and destroyed, writing out what is left, together with the sink
+    auto writer = std::make_shared<BufferedFileWriter>(p.string(), options);
+    const LogLevel flushLevel = options.flushLevel;
+
+    LogSink sink = [writer, flushLevel](const LogMessage &message, std::string_view time)
+    {
+        // Formatted before taking the writer's lock so concurrent callers only serialise on the copy
+        const std::string_view line = FormatFileLine(message, time);
+        writer->Write(line, message.level >= flushLevel);
+        CountSinkBytes(line.size());
+    };
+
+    auto state = std::make_shared<LogSinkState>(name, true, nullptr, false, std::move(sink));
+    state->writeText = [writer](std::string_view text) { writer->Write(text, false); };
+    state->flush = [writer](bool force) { writer->Flush(force); };
+    state->writeCrashMarker = [writer](std::string_view marker) { writer->WriteCrashMarker(marker); };
+
+    PrintOpenMessage(*state);
+
+    RegisterSink(std::move(state), minLevel, maxLevel);
+    ScheduleSinkFlush(options.flushInterval);
 }
 
-void ae::Logger::Close()
+#ifdef AE_LINUX
+void ae::Logger::AddUringFileSink(const std::string &name, const std::string &path,
+                                  const LogUringFileOptions &options, LogLevel minLevel, LogLevel maxLevel)
 {
-    try
+#ifdef AE_DIST
+    std::println("WARNING: Attempted to add an io_uring file sink to Logger. This was skipped since log system "
+                 "removes all logs from dist builds, making the action redundant");
+    return;
+#endif // AE_DIST
+    if (HasSink(name))
     {
-        m_ExecutionTimer.Stop();
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
+    }
+
+    if (options.bufferSize == 0 || options.bufferCount == 0)
+    {
+        AE_THROW_INVALID_ARGUMENT("Buffer size and count of io_uring file sink '{}' must be greater than zero", name);
+    }
+
+    std::filesystem::path p = path;
+    CreateParentDirectories(name, p);
+
+    auto writer = std::make_shared<UringFileWriter>(p.string(), options);
+
+    if (!writer->UsesRing())
+    {
+        AE_LOG_WARNING("io_uring is unavailable, sink '{}' writes with pwrite instead", name);
+    }
+
+    LogSink sink = [writer](const LogMessage &message, std::string_view time)
+    {
+        const std::string_view line = FormatFileLine(message, time);
+        writer->Write(line);
+        CountSinkBytes(line.size());
+    };
+
+    auto state = std::make_shared<LogSinkState>(name, true, nullptr, false, std::move(sink));
+    state->writeText = [writer](std::string_view text) { writer->Write(text); };
+    state->flush = [writer](bool force) { writer->Flush(force); };
+    state->writeCrashMarker = [writer](std::string_view marker) { writer->WriteCrashMarker(marker); };
+
+    PrintOpenMessage(*state);
+
+    RegisterSink(std::move(state), minLevel, maxLevel);
+    ScheduleSinkFlush(options.flushInterval);
+}
+#endif // AE_LINUX
+
+void ae::Logger::AddBinaryFileSink(const std::string &name, const std::string &path, LogLevel minLevel,
+                                   LogLevel maxLevel)
+{
+#ifdef AE_DIST
+    std::println("WARNING: Attempted to add a binary file sink to Logger. This was skipped since log system removes "
+                 "all logs from dist builds, making the action redundant");
+    return;
+#endif // AE_DIST
+    if (HasSink(name))
+    {
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
+    }
+
+    std::filesystem::path p = path;
+    CreateParentDirectories(name, p);
 
-        /*
-        for (auto& [name, sink] : m_Sinks)
+    auto writer = std::make_shared<BinaryFileWriter>(p.string());
+
+    LogSink sink = [writer](const LogMessage &message, std::string_view) { CountSinkBytes(writer->Write(message)); };
+
+    auto state = std::make_shared<LogSinkState>(name, true, nullptr, false, std::move(sink));
+    state->wantsArguments = true;
+    state->writeText = [writer](std::string_view text) { writer->WriteText(text); };
+    state->flush = [writer](bool force)
+    {
+        if (force)
         {
-                // Cleanup if necessary
+            writer->Flush();
         }
-        */
+    };
+    // Raw text would break the record layout, only the pending records are written
+    state->writeCrashMarker = [writer](std::string_view) { writer->WriteBufferOnCrash(); };
+
+    PrintOpenMessage(*state);
+
+    RegisterSink(std::move(state), minLevel, maxLevel);
+}
+
+void ae::Logger::AddStructuredFileSink(const std::string &name, const std::string &path, LogStructuredKind kind,
+                                       LogLevel minLevel, LogLevel maxLevel)
+{
+#ifdef AE_DIST
+    std::println("WARNING: Attempted to add a structured file sink to Logger. This was skipped since log system "
+                 "removes all logs from dist builds, making the action redundant");
+    return;
+#endif // AE_DIST
+    if (HasSink(name))
+    {
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
+    }
+
+    std::filesystem::path p = path;
+    CreateParentDirectories(name, p);
+
+    FILE *stream = nullptr;
+
+#ifdef AE_WINDOWS
+    errno_t res = fopen_s(&stream, p.string().c_str(), "w");
+
+    if (res != 0 || stream == nullptr)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open log sink '{}' at '{}'. Error code: {}", name, p.string(), res);
+    }
+#else
+    stream = std::fopen(p.string().c_str(), "w");
+
+    if (!stream)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open log sink '{}' at '{}'", name, p.string());
+    }
+#endif
 
-        m_Sinks.clear();
+    LogSink sink = [stream, kind](const LogMessage &message, std::string_view)
+    {
+        thread_local std::string line;
+        line.clear();
 
-        for (auto &[name, stream] : m_Streams)
+        if (kind == LogStructuredKind::LOGFMT)
         {
-            PrintTerminationMessage(stream);
+            AppendLogfmtLine(line, message);
         }
 
-        for (auto &[name, stream] : m_FileStreams)
+        else
         {
-            std::fclose(stream);
+            AppendJsonLine(line, message);
         }
 
-        m_FileStreams.clear();
-    }
+        std::fwrite(line.data(), 1, line.size(), stream);
+        CountSinkBytes(line.size());
+    };
 
-    catch (std::exception &e)
-    {
-        std::println("Unexpected exception thrown when closing Logger\n");
-        std::println("Message: {}", e.what());
-    }
+    auto state = std::make_shared<LogSinkState>(name, true, stream, true, std::move(sink));
+    state->wantsFields = true;
+    // Free text would break parsers expecting one record per line
+    state->writeText = [](std::string_view) {};
+    state->writeCrashMarker = [stream](std::string_view) { WriteStreamBufferOnCrash(stream); };
+
+    RegisterSink(std::move(state), minLevel, maxLevel);
 }
 
-void ae::Logger::PrintOpenMessage(FILE *stream) const
+void ae::Logger::AddRingFileSink(const std::string &name, const std::string &path, size_t capacity,
+                                 LogLevel minLevel, LogLevel maxLevel)
 {
-    std::println(stream, "{}", m_OpenMessage);
+#ifdef AE_DIST
+    std::println("WARNING: Attempted to add a ring file sink to Logger. This was skipped since log system removes all "
+                 "logs from dist builds, making the action redundant");
+    return;
+#endif // AE_DIST
+    if (HasSink(name))
+    {
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
+    }
+
+    if (capacity == 0)
+    {
+        AE_THROW_INVALID_ARGUMENT("Capacity of ring file sink '{}' must be greater than zero", name);
+    }
 
-    std::println(stream, "\nExecution started at:\n{} {}", m_StartDate, m_StartTime);
+    std::filesystem::path p = path;
+    CreateParentDirectories(name, p);
 
-    std::println(stream, "\nSink opened at:\n{} {}", DateTime::DateAsString(), DateTime::TimeAsString());
+    auto writer = std::make_shared<RingFileWriter>(p.string(), capacity);
 
-    if (std::expected<std::string, TimeZoneError> tz = DateTime::TimeZoneAsString())
+    LogSink sink = [writer](const LogMessage &message, std::string_view time)
     {
-        std::println(stream, "\nTime zone: {}\n", *tz);
-    }
+        const std::string_view line = FormatFileLine(message, time);
+        writer->Write(line);
+        CountSinkBytes(line.size());
+    };
 
-    else
+    auto state = std::make_shared<LogSinkState>(name, true, nullptr, false, std::move(sink));
+    state->writeText = [writer](std::string_view text) { writer->Write(text); };
+    state->flush = [writer](bool force)
     {
-        std::println(stream, "\nUnknown time zone ({})\n", to_string(tz.error()));
-    }
+        if (force)
+        {
+            writer->Flush();
+        }
+    };
+    // Nothing is buffered and copying into the mapping is safe inside a signal handler
+    state->writeCrashMarker = [writer](std::string_view marker) { writer->Write(marker); };
+
+    PrintOpenMessage(*state);
+
+    RegisterSink(std::move(state), minLevel, maxLevel);
 }
 
-void ae::Logger::PrintCloseMessage(FILE *stream) const
+void ae::Logger::AddCallbackSink(const std::string &name, LogSink sink, LogLevel minLevel, LogLevel maxLevel)
 {
-    std::println(stream, "\nSink closed at:\n{} {}", DateTime::DateAsString(), DateTime::TimeAsString());
+#ifdef AE_DIST
+    std::println("WARNING: Attempted to add a callback sink to Logger. This was skipped since log system removes all "
+                 "logs from dist builds, making the action redundant");
+    return;
+#endif // AE_DIST
+    if (HasSink(name))
+    {
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+        return;
+    }
+
+    auto state = std::make_shared<LogSinkState>(name, false, nullptr, false, std::move(sink));
+    RegisterSink(std::move(state), minLevel, maxLevel);
 }
 
-void ae::Logger::PrintTerminationMessage(FILE *stream) const
+void ae::Logger::RemoveSink(const std::string &name)
 {
-    std::println(stream, "\nClosed by termination at:\n{} {}", DateTime::DateAsString(), DateTime::TimeAsString());
+    const bool removed = m_SinkRegistry->Update(
+        [&name](LogSinkSnapshot &snapshot)
+        {
+            const auto matches = [&name](const LogSinkSlot &slot) { return slot.state->name == name; };
+            return std::erase_if(snapshot.sinks, matches) > 0;
+        });
+
+    if (!removed)
+    {
+        AE_LOG_WARNING("Tried to remove sink with name '{}' but it does not exist", name);
+    }
+}
+
+void ae::Logger::SetSinkLevels(const std::string &name, LogLevel minLevel, LogLevel maxLevel)
+{
+    const bool updated = m_SinkRegistry->Update(
+        [&](LogSinkSnapshot &snapshot)
+        {
+            for (LogSinkSlot &slot : snapshot.sinks)
+            {
+                if (slot.state->name == name)
+                {
+                    slot.minLevel = minLevel;
+                    slot.maxLevel = maxLevel;
+                    return true;
+                }
+            }
+
+            return false;
+        });
+
+    if (!updated)
+    {
+        AE_LOG_WARNING("Tried to set levels of sink with name '{}' but it does not exist", name);
+    }
+}
+
+void ae::Logger::Close()
+{
+    try
+    {
+        m_ExecutionTimer.Stop();
+
+        // Reports log, so they end while the sinks are still there
+        m_StatsReporter->Stop();
+        WriteDeduplicatedRepeats();
+
+        if (m_AsyncWorker.joinable())
+        {
+            // Producers load the queue inside a read section. Once every section that could have seen it has ended
+            // nothing is pushed anymore, and the backend drains the rest before it stops.
+            m_AsyncQueue.store(nullptr, std::memory_order_seq_cst);
+            m_SinkRegistry->WaitForReaders();
+
+            m_AsyncStopRequested.store(true, std::memory_order_seq_cst);
+            WakeAsyncWorker();
+            m_AsyncWorker.join();
+        }
+
+        {
+            const auto sinks = m_SinkRegistry->Read();
+
+            for (const LogSinkSlot &slot : sinks->sinks)
+            {
+                PrintTerminationMessage(*slot.state);
+            }
+        }
+
+        // Retiring the last snapshot closes the files, buffered sinks write out what is still pending
+        m_SinkRegistry->Update(
+            [](LogSinkSnapshot &snapshot)
+            {
+                snapshot.sinks.clear();
+                return true;
+            });
+    }
+
+    catch (std::exception &e)
+    {
+        std::println("Unexpected exception thrown when closing Logger\n");
+        std::println("Message: {}", e.what());
+    }
+}
+
+void ae::Logger::EnableAsync(size_t capacity, AsyncOverflowPolicy policy, AsyncFormatMode formatMode)
+{
+    if (capacity == 0)
+    {
+        AE_THROW_INVALID_ARGUMENT("Async log queue capacity must be greater than zero");
+    }
+
+    if (IsAsync())
+    {
+        AE_LOG_WARNING("Tried to enable async logging but it is already enabled");
+        return;
+    }
+
+    m_AsyncQueueStorage = std::make_unique<AsyncLogQueue>(capacity);
+    m_AsyncPolicy = policy;
+    m_AsyncStopRequested.store(false, std::memory_order_relaxed);
+    m_AsyncWorker = std::thread(&Logger::RunAsyncWorker, this);
+
+    m_AsyncQueue.store(m_AsyncQueueStorage.get(), std::memory_order_release);
+    m_DeferredFormatting.store(formatMode == AsyncFormatMode::DEFERRED, std::memory_order_relaxed);
+}
+
+void ae::Logger::InstallCrashHandler()
+{
+    // Logger::Get is not async-signal-safe and may run after the Logger is destroyed, the handler uses this instead
+    InstallCrashHandlers([](void *logger, std::string_view marker)
+                         { static_cast<const Logger *>(logger)->WriteCrashMarker(marker); },
+                         this);
+}
+
+void ae::Logger::Flush()
+{
+    WriteDeduplicatedRepeats();
+
+    uint64_t ticket = 0;
+
+    {
+        const auto section = m_SinkRegistry->Read();
+        AsyncLogQueue *queue = GetAsyncQueue();
+
+        if (queue == nullptr)
+        {
+            FlushStreams();
+            return;
+        }
+
+        ticket = m_FlushRequested.fetch_add(1, std::memory_order_relaxed) + 1;
+        EnqueueFlush(*queue, ticket);
+    }
+
+    uint64_t completed = m_FlushCompleted.load(std::memory_order_acquire);
+
+    while (completed < ticket)
+    {
+        m_FlushCompleted.wait(completed, std::memory_order_acquire);
+        completed = m_FlushCompleted.load(std::memory_order_acquire);
+    }
+}
+
+void ae::Logger::EnableLoadShedding(const LogLoadSheddingOptions &options)
+{
+    if (options.latencyBudget.count() <= 0)
+    {
+        AE_THROW_INVALID_ARGUMENT("Load shedding latency budget must be greater than zero");
+    }
+
+    const auto maxShedLevel = std::min(options.maxShedLevel, LogLevel::WARNING);
+
+    m_ShedRecovery.store(std::chrono::nanoseconds(options.recoveryDelay).count(), std::memory_order_relaxed);
+    m_ShedMaxLevels.store(static_cast<uint8_t>(static_cast<uint8_t>(maxShedLevel) + 1), std::memory_order_relaxed);
+    m_ShedBudget.store(std::chrono::nanoseconds(options.latencyBudget).count(), std::memory_order_relaxed);
+}
+
+bool ae::Logger::ShedMessage(LogLevel level) const
+{
+    // Without writes nothing measures the sinks anymore, so dropped messages also check whether to ease off
+    const int64_t now = SteadyNanos();
+    UpdateLoadShedding(0, now);
+
+    if (static_cast<uint8_t>(level) >= m_ShedLevels.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+
+    m_ShedMessages.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ae::Logger::UpdateLoadShedding(int64_t slowestNanos, int64_t now) const
+{
+    const int64_t budget = m_ShedBudget.load(std::memory_order_relaxed);
+    uint8_t levels = m_ShedLevels.load(std::memory_order_relaxed);
+
+    if (budget == 0)
+    {
+        return;
+    }
+
+    if (slowestNanos > budget)
+    {
+        m_ShedPressureTime.store(now, std::memory_order_relaxed);
+
+        // Gives the previous step time to take effect before dropping another level
+        if (levels >= m_ShedMaxLevels.load(std::memory_order_relaxed) ||
+            now - m_ShedChangeTime.load(std::memory_order_relaxed) < c_ShedStepNanos ||
+            !m_ShedLevels.compare_exchange_strong(levels, static_cast<uint8_t>(levels + 1), std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        m_ShedChangeTime.store(now, std::memory_order_relaxed);
+
+        if (levels == 0)
+        {
+            m_ShedMessagesAtStart.store(m_ShedMessages.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        std::array<char, 160> text{};
+        const auto end = std::format_to_n(text.data(), text.size(),
+                                          "Sink writes average {} us, over the budget of {} us. Dropping {} messages "
+                                          "and below",
+                                          slowestNanos / 1000, budget / 1000, c_LevelLookup[levels])
+                             .out;
+        WriteSheddingNotice({ text.data(), end });
+        return;
+    }
+
+    const int64_t recovery = m_ShedRecovery.load(std::memory_order_relaxed);
+
+    if (levels == 0 || now - m_ShedPressureTime.load(std::memory_order_relaxed) < recovery ||
+        now - m_ShedChangeTime.load(std::memory_order_relaxed) < recovery ||
+        !m_ShedLevels.compare_exchange_strong(levels, static_cast<uint8_t>(levels - 1), std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    m_ShedChangeTime.store(now, std::memory_order_relaxed);
+
+    if (levels == 1)
+    {
+        const uint64_t shed = m_ShedMessages.load(std::memory_order_relaxed) -
+                              m_ShedMessagesAtStart.load(std::memory_order_relaxed);
+
+        std::array<char, 160> text{};
+        const auto end = std::format_to_n(text.data(), text.size(),
+                                          "Load shedding ended, {} messages were dropped", shed)
+                             .out;
+        WriteSheddingNotice({ text.data(), end });
+    }
+}
+
+void ae::Logger::WriteSheddingNotice(std::string_view text) const
+{
+    static constexpr LogCallSiteInfo site =
+        MakeLogCallSiteInfo(LogLevel::WARNING, std::source_location::current(), "Load shedding");
+
+    const LogMessage message{ .site = &site,
+                              .level = site.level,
+                              .time = Clock::Now(),
+                              .message = text,
+                              .arguments = {},
+                              .fields = {} };
+
+    Dispatch(message);
+}
+
+void ae::Logger::EnableBacktrace(size_t capacity, LogLevel triggerLevel)
+{
+    if (capacity == 0)
+    {
+        m_BacktraceLevels.store(0, std::memory_order_relaxed);
+    }
+
+    else
+    {
+        m_BacktraceCapacity.store(capacity, std::memory_order_relaxed);
+        m_BacktraceLevels.store(static_cast<uint8_t>((1u << static_cast<uint32_t>(triggerLevel)) - 1),
+                                std::memory_order_relaxed);
+    }
+
+    // Call sites have cached that nothing takes the levels the backtrace now keeps
+    g_LogGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void ae::Logger::LogTimerStats(LogLevel level) const
+{
+    for (TimerStats *stats : TimerStats::GetAll())
+    {
+        LogTimerSummary(level, stats->GetName(), stats->GetSummary());
+    }
+}
+
+void ae::Logger::EnableTimerStatsReport(std::chrono::milliseconds interval, LogLevel level)
+{
+    m_StatsReporter->Schedule(StatsReportKind::TIMER_STATS, interval,
+                              [this, level]()
+                              {
+                                  for (TimerStats *stats : TimerStats::GetAll())
+                                  {
+                                      const LatencySummary summary = stats->TakeIntervalSummary();
+
+                                      if (summary.count != 0)
+                                      {
+                                          LogTimerSummary(level, stats->GetName(), summary);
+                                      }
+                                  }
+                              });
+}
+
+void ae::Logger::LogTimerSummary(LogLevel level, std::string_view name, const LatencySummary &summary) const
+{
+    std::string line;
+    std::format_to(std::back_inserter(line), "Timer '{}': {} samples, mean ", name, summary.count);
+    AppendDuration(line, summary.mean);
+
+    const std::array<std::pair<std::string_view, std::chrono::nanoseconds>, 6> values = { {
+        { ", min ", summary.min },
+        { ", p50 ", summary.p50 },
+        { ", p90 ", summary.p90 },
+        { ", p99 ", summary.p99 },
+        { ", p99.9 ", summary.p999 },
+        { ", max ", summary.max },
+    } };
+
+    for (const auto &[label, value] : values)
+    {
+        line += label;
+        AppendDuration(line, value);
+    }
+
+    Log(level, std::source_location::current(), "{}", line);
+}
+
+ae::LoggerStats ae::Logger::GetStats() const
+{
+    LoggerStats stats;
+    SumLogThreadCounters(stats.levels);
+
+    {
+        const auto sinks = m_SinkRegistry->Read();
+        stats.sinks.reserve(sinks->sinks.size());
+
+        for (const LogSinkSlot &slot : sinks->sinks)
+        {
+            stats.sinks.push_back(LogSinkStats{ .name = slot.state->name,
+                                                .messages = slot.state->messages.load(std::memory_order_relaxed),
+                                                .bytes = slot.state->bytes.load(std::memory_order_relaxed),
+                                                .latency = slot.state->latency.Summarize() });
+        }
+    }
+
+    stats.asyncDropped = GetDroppedMessageCount();
+    stats.shed = GetShedMessageCount();
+
+    return stats;
+}
+
+void ae::Logger::EnableSinkLatencyStats(bool enabled)
+{
+    m_SinkLatencyStats.store(enabled, std::memory_order_relaxed);
+}
+
+void ae::Logger::EnableHealthReport(std::chrono::milliseconds interval, LogLevel level)
+{
+    m_StatsReporter->Schedule(StatsReportKind::HEALTH, interval,
+                              [this, level, previous = GetStats(), since = std::chrono::steady_clock::now()]() mutable
+                              {
+                                  LoggerStats current = GetStats();
+                                  const auto now = std::chrono::steady_clock::now();
+
+                                  LogHealth(level, previous, current, now - since);
+
+                                  previous = std::move(current);
+                                  since = now;
+                              });
+}
+
+void ae::Logger::LogHealth(LogLevel level, const LoggerStats &previous, const LoggerStats &current,
+                           std::chrono::steady_clock::duration interval) const
+{
+    uint64_t written = 0;
+    uint64_t filtered = 0;
+
+    for (size_t i = 0; i < c_LogLevelCount; ++i)
+    {
+        written += current.levels[i].written - previous.levels[i].written;
+        filtered += current.levels[i].filtered - previous.levels[i].filtered;
+    }
+
+    std::string line;
+    std::format_to(std::back_inserter(line), "Logger health over ");
+    AppendDuration(line, std::chrono::duration_cast<std::chrono::nanoseconds>(interval));
+    std::format_to(std::back_inserter(line), ": {} written, {} filtered, {} dropped, {} shed", written, filtered,
+                   current.asyncDropped - previous.asyncDropped, current.shed - previous.shed);
+
+    const double intervalNanos =
+        static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count());
+
+    for (const LogSinkStats &sink : current.sinks)
+    {
+        // A sink added during the interval is compared against nothing
+        LogSinkStats before{};
+
+        for (const LogSinkStats &candidate : previous.sinks)
+        {
+            if (candidate.name == sink.name)
+            {
+                before = candidate;
+                break;
+            }
+        }
+
+        std::format_to(std::back_inserter(line), "; '{}' {} messages, {} bytes", sink.name,
+                       sink.messages - before.messages, sink.bytes - before.bytes);
+
+        if (sink.latency.count != before.latency.count && intervalNanos > 0)
+        {
+            const double busy = static_cast<double>((sink.latency.total - before.latency.total).count());
+            std::format_to(std::back_inserter(line), ", {:.1f} % busy", 100.0 * busy / intervalNanos);
+        }
+    }
+
+    Log(level, std::source_location::current(), "{}", line);
+}
+
+bool ae::Logger::UpdateBacktrace(const LogMessage &message, DeferredDecodeFn decoder,
+                                 std::span<const std::byte> arguments) const
+{
+    const uint8_t levels = m_BacktraceLevels.load(std::memory_order_relaxed);
+
+    if ((levels & (1u << static_cast<uint32_t>(message.level))) != 0)
+    {
+        if (IsLevelEnabled(message.level))
+        {
+            return false;
+        }
+
+        t_Backtrace.Push(m_BacktraceCapacity.load(std::memory_order_relaxed), message, decoder, arguments);
+        LogThreadCounters::Increase(GetLogThreadCounters().filtered[static_cast<size_t>(message.level)]);
+        return true;
+    }
+
+    // Every level below the trigger is kept, so any other level triggers
+    if (levels != 0 && !t_Backtrace.IsEmpty())
+    {
+        WriteBacktrace(message.level);
+    }
+
+    return false;
+}
+
+void ae::Logger::WriteBacktrace(LogLevel sinkLevel) const
+{
+    const auto section = m_SinkRegistry->Read();
+    AsyncLogQueue *queue = GetAsyncQueue();
+
+    // Deferred messages are formatted here rather than on the backend, this only happens on the way to an error
+    t_Backtrace.Drain(
+        [this, queue, sinkLevel](const LogMessage &message)
+        {
+            if (queue == nullptr)
+            {
+                WriteToSinks(message, sinkLevel);
+                return;
+            }
+
+            Enqueue(
+                *queue,
+                [&message, sinkLevel](AsyncLogRecord &record)
+                {
+                    record.kind = AsyncRecordKind::MESSAGE;
+                    record.decoder = nullptr;
+                    record.binaryArguments.clear();
+                    record.fields.assign(message.fields.begin(), message.fields.end());
+                    record.text.assign(message.message);
+                    record.message = message;
+                    record.sinkLevel = sinkLevel;
+                },
+                m_AsyncPolicy);
+        });
+}
+
+void ae::Logger::Dispatch(const LogMessage &message) const
+{
+    if (m_BacktraceLevels.load(std::memory_order_relaxed) != 0 && UpdateBacktrace(message, nullptr, {}))
+    {
+        return;
+    }
+
+    const auto section = m_SinkRegistry->Read();
+    AsyncLogQueue *queue = GetAsyncQueue();
+
+    if (queue == nullptr)
+    {
+        WriteToSinks(message);
+        return;
+    }
+
+    Enqueue(
+        *queue,
+        [&message](AsyncLogRecord &record)
+        {
+            record.kind = AsyncRecordKind::MESSAGE;
+            record.decoder = nullptr;
+            record.binaryArguments.assign(message.arguments.begin(), message.arguments.end());
+            record.fields.assign(message.fields.begin(), message.fields.end());
+            record.text.assign(message.message);
+            record.message = message;
+            record.sinkLevel = message.level;
+        },
+        m_AsyncPolicy);
+}
+
+void ae::Logger::DispatchDeferred(const LogMessage &message, DeferredDecodeFn decoder,
+                                  std::span<const std::byte> arguments) const
+{
+    if (m_BacktraceLevels.load(std::memory_order_relaxed) != 0 && UpdateBacktrace(message, decoder, arguments))
+    {
+        return;
+    }
+
+    const auto section = m_SinkRegistry->Read();
+    AsyncLogQueue *queue = GetAsyncQueue();
+
+    if (queue == nullptr)
+    {
+        // Async logging was shut down after the caller checked or this is the backend, format here instead
+        std::string &text = GetFormatBuffer();
+        text.clear();
+        decoder(message.site->format, arguments.data(), text);
+
+        LogMessage formatted = message;
+        formatted.message = text;
+        WriteToSinks(formatted);
+        return;
+    }
+
+    Enqueue(
+        *queue,
+        [&message, decoder, arguments](AsyncLogRecord &record)
+        {
+            record.kind = AsyncRecordKind::MESSAGE;
+            record.message.site = message.site;
+            record.message.level = message.level;
+            record.message.time = message.time;
+            record.sinkLevel = message.level;
+            record.decoder = decoder;
+            record.arguments.assign(arguments.begin(), arguments.end());
+            record.binaryArguments.assign(message.arguments.begin(), message.arguments.end());
+            record.fields.clear();
+        },
+        m_AsyncPolicy);
+}
+
+void ae::Logger::DispatchNewline(LogNewlineKind kind) const
+{
+    const auto section = m_SinkRegistry->Read();
+    AsyncLogQueue *queue = GetAsyncQueue();
+
+    if (queue == nullptr)
+    {
+        WriteNewline(kind);
+        return;
+    }
+
+    Enqueue(
+        *queue,
+        [kind](AsyncLogRecord &record)
+        {
+            record.kind = AsyncRecordKind::NEWLINE;
+            record.newline = kind;
+        },
+        m_AsyncPolicy);
+}
+
+const ae::LogCallSiteInfo &ae::Logger::InternCallSite(LogLevel level, std::source_location loc, std::string_view fmt,
+                                                      bool keepFormat) const
+{
+    // Deferred messages are formatted with the site's format, so a wrapper logging several formats from one location
+    // needs a site for each of them
+    const uint64_t id = HashLogCallSite(loc.file_name(), loc.line(), loc.column(), level, fmt, keepFormat);
+
+    if (const auto cached = t_InternedCallSites.find(id); cached != t_InternedCallSites.end())
+    {
+        return *cached->second;
+    }
+
+    std::scoped_lock lock(m_CallSiteMutex);
+
+    // Nodes of an unordered_map never move, so the returned reference stays valid for the Logger's lifetime
+    auto it = m_InternedCallSites.try_emplace(id, LogCallSiteInfo{ .level = level,
+                                                                   .file = GetFileName(loc.file_name()),
+                                                                   .function = loc.function_name(),
+                                                                   .line = loc.line(),
+                                                                   .format = keepFormat ? fmt : std::string_view{},
+                                                                   .id = id })
+                  .first;
+
+    t_InternedCallSites.emplace(id, &it->second);
+    return it->second;
+}
+
+ae::AsyncLogQueue *ae::Logger::GetAsyncQueue() const
+{
+    if (t_OnAsyncWorker)
+    {
+        return nullptr;
+    }
+
+    // Sequentially consistent with the read section entered before, see Close
+    return m_AsyncQueue.load(std::memory_order_seq_cst);
+}
+
+void ae::Logger::EnqueueFlush(AsyncLogQueue &queue, uint64_t ticket) const
+{
+    // The marker must never be dropped, otherwise the caller would wait forever
+    Enqueue(
+        queue,
+        [ticket](AsyncLogRecord &record)
+        {
+            record.kind = AsyncRecordKind::FLUSH;
+            record.flushTicket = ticket;
+        },
+        AsyncOverflowPolicy::BLOCK);
+}
+
+void ae::Logger::WakeAsyncWorker() const
+{
+    // Only the producer that finds the backend parked pays for the wake-up
+    if (m_AsyncWorkerParked.load(std::memory_order_seq_cst) &&
+        m_AsyncWorkerParked.exchange(false, std::memory_order_seq_cst))
+    {
+        m_AsyncWorkerParked.notify_one();
+    }
+}
+
+template <class Writer>
+void ae::Logger::Enqueue(AsyncLogQueue &queue, Writer &&write, AsyncOverflowPolicy policy) const
+{
+    switch (policy)
+    {
+    case AsyncOverflowPolicy::BLOCK:
+        while (!queue.TryPush(write))
+        {
+            std::this_thread::yield();
+        }
+        break;
+    case AsyncOverflowPolicy::DROP_NEWEST:
+        if (!queue.TryPush(write))
+        {
+            m_AsyncDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        break;
+    case AsyncOverflowPolicy::DROP_OLDEST:
+        while (!queue.TryPush(write))
+        {
+            // TryPop hands this record's buffers to the ring cell, reusing one keeps their capacity in circulation
+            thread_local AsyncLogRecord evicted;
+
+            if (queue.TryPop(evicted))
+            {
+                if (evicted.kind == AsyncRecordKind::FLUSH)
+                {
+                    // Flush markers are owed to a waiting caller, put it back at the tail instead
+                    EnqueueFlush(queue, evicted.flushTicket);
+                }
+
+                else if (evicted.kind != AsyncRecordKind::SKIPPED)
+                {
+                    m_AsyncDropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+        break;
+    }
+
+    WakeAsyncWorker();
+}
+
+void ae::Logger::WriteToSinks(const LogMessage &message, LogLevel sinkLevel) const
+{
+    // Rendered once from the message itself so every sink shows the same time, also when written later by the
+    // async backend. Copied out of the thread's cache, which a sink that logs renders its own time into.
+    std::array<char, 16> timeText{};
+    const std::string_view cachedTime = DateTime::LogTimeAsString(Clock::ToSystemTime(message.time));
+    const size_t timeSize = cachedTime.copy(timeText.data(), timeText.size());
+    const std::string_view time(timeText.data(), timeSize);
+    const auto sinks = m_SinkRegistry->Read();
+
+    const LogNestingScope nesting;
+
+    // Sinks that do not understand fields get them as text, rendered once on the first such sink
+    thread_local std::deque<std::string> fieldTexts;
+    std::string &fieldText = GetNestedBuffer(fieldTexts);
+    LogMessage withFieldText{};
+    bool fieldTextRendered = false;
+
+    const auto &targets = sinks->byLevel[static_cast<size_t>(sinkLevel)];
+
+    // Backtrace messages were counted as filtered when they were kept
+    if (sinkLevel == message.level)
+    {
+        LogThreadCounters &counters = GetLogThreadCounters();
+        LogThreadCounters::Increase(targets.empty() ? counters.filtered[static_cast<size_t>(message.level)]
+                                                    : counters.written[static_cast<size_t>(message.level)]);
+    }
+
+    // Sink writes are only timed while load shedding or sink latency stats are enabled
+    const bool shedding = m_ShedBudget.load(std::memory_order_relaxed) != 0;
+    const bool measured = m_SinkLatencyStats.load(std::memory_order_relaxed);
+    const bool timed = shedding || measured;
+    int64_t slowest = 0;
+    int64_t now = timed ? SteadyNanos() : 0;
+
+    for (const LogSinkState *state : targets)
+    {
+        t_SinkBytes = 0;
+
+        CallSink(*state,
+                 [&]
+                 {
+                     if (message.fields.empty() || state->wantsFields)
+                     {
+                         state->sink(message, time);
+                         return;
+                     }
+
+                     if (!fieldTextRendered)
+                     {
+                         withFieldText.site = message.site;
+                         withFieldText.level = message.level;
+                         withFieldText.time = message.time;
+                         fieldText.clear();
+                         AppendFieldText(fieldText, message);
+                         withFieldText.message = fieldText;
+                         fieldTextRendered = true;
+                     }
+
+                     state->sink(withFieldText, time);
+                 });
+
+        state->messages.fetch_add(1, std::memory_order_relaxed);
+        state->bytes.fetch_add(t_SinkBytes, std::memory_order_relaxed);
+
+        if (timed)
+        {
+            const int64_t start = std::exchange(now, SteadyNanos());
+
+            if (measured)
+            {
+                state->latency.RecordShared(static_cast<uint64_t>(now - start));
+            }
+
+            if (shedding)
+            {
+                const int64_t average = state->averageNanos.load(std::memory_order_relaxed);
+
+                // Moving average over roughly the last eight writes
+                const int64_t updated = average + (now - start - average) / 8;
+                state->averageNanos.store(updated, std::memory_order_relaxed);
+                slowest = std::max(slowest, updated);
+            }
+        }
+    }
+
+    if (shedding)
+    {
+        UpdateLoadShedding(slowest, now);
+    }
+}
+
+void ae::Logger::FlushStreams(bool force) const
+{
+    const auto sinks = m_SinkRegistry->Read();
+
+    for (const LogSinkSlot &slot : sinks->sinks)
+    {
+        CallSink(*slot.state, [&] { slot.state->Flush(force); });
+    }
+}
+
+void ae::Logger::ScheduleSinkFlush(std::chrono::milliseconds interval)
+{
+    if (interval.count() <= 0)
+    {
+        return;
+    }
+
+    std::scoped_lock lock(m_SinkFlushMutex);
+
+    if (m_SinkFlushInterval.count() != 0 && m_SinkFlushInterval <= interval)
+    {
+        return;
+    }
+
+    m_SinkFlushInterval = interval;
+
+    // Flush(false) only writes out lines older than their sink's interval, checking twice per interval bounds how long
+    // a line waits on a quiet sink. The timer stays after the sink is removed, a pass over the other sinks is cheap.
+    m_StatsReporter->Schedule(StatsReportKind::SINK_FLUSH, std::max(interval / 2, std::chrono::milliseconds(1)),
+                              [this]() { FlushStreams(false); });
+}
+
+bool ae::Logger::HasSink(const std::string &name) const
+{
+    const auto sinks = m_SinkRegistry->Read();
+    return sinks->Find(name) != nullptr;
+}
+
+void ae::Logger::RegisterSink(std::shared_ptr<LogSinkState> state, LogLevel minLevel, LogLevel maxLevel)
+{
+    const std::string name = state->name;
+
+    const bool added = m_SinkRegistry->Update(
+        [&](LogSinkSnapshot &snapshot)
+        {
+            if (snapshot.Find(name) != nullptr)
+            {
+                return false;
+            }
+
+            snapshot.sinks.push_back(LogSinkSlot{ std::move(state), minLevel, maxLevel });
+            return true;
+        });
+
+    if (!added)
+    {
+        AE_LOG_WARNING("Tried to add sink with name '{}' but it already exists", name);
+    }
+}
+
+bool ae::LogDeduplicator::Deduplicate(const LogCallSiteInfo &site, std::string_view message, uint64_t &repeated)
+{
+    std::scoped_lock lock(m_Mutex);
+    m_Site = &site;
+
+    if (m_HasPrevious && message == m_Previous)
+    {
+        ++m_Repeated;
+        return false;
+    }
+
+    m_Previous.assign(message);
+    m_HasPrevious = true;
+    repeated = std::exchange(m_Repeated, 0);
+    return true;
+}
+
+uint64_t ae::LogDeduplicator::TakeRepeated(const LogCallSiteInfo *&site)
+{
+    std::scoped_lock lock(m_Mutex);
+
+    if (m_Site != nullptr)
+    {
+        site = m_Site;
+    }
+
+    return std::exchange(m_Repeated, 0);
+}
+
+ae::LogDeduplicator &ae::Logger::AddDeduplicator()
+{
+    std::scoped_lock lock(m_DeduplicatorMutex);
+    return *m_Deduplicators.emplace_back(std::make_unique<LogDeduplicator>());
+}
+
+void ae::Logger::DispatchRepeated(const LogCallSiteInfo &site, uint64_t repeated,
+                                  std::chrono::steady_clock::time_point time) const
+{
+    std::array<char, 64> summary{};
+    const auto end =
+        std::format_to_n(summary.data(), summary.size(), "Previous message repeated {} more times", repeated).out;
+
+    Dispatch(LogMessage{ .site = &site,
+                         .level = site.level,
+                         .time = time,
+                         .message = std::string_view(summary.data(), end),
+                         .arguments = {},
+                         .fields = {} });
+}
+
+void ae::Logger::WriteDeduplicatedRepeats()
+{
+    // Written without the lock, a sink that logs could reach a deduplicating site for the first time
+    std::vector<LogDeduplicator *> deduplicators;
+
+    {
+        std::scoped_lock lock(m_DeduplicatorMutex);
+
+        for (const std::unique_ptr<LogDeduplicator> &deduplicator : m_Deduplicators)
+        {
+            deduplicators.push_back(deduplicator.get());
+        }
+    }
+
+    for (LogDeduplicator *deduplicator : deduplicators)
+    {
+        const LogCallSiteInfo *site = nullptr;
+        const uint64_t repeated = deduplicator->TakeRepeated(site);
+
+        if (repeated != 0 && site != nullptr && !IsShed(site->level))
+        {
+            DispatchRepeated(*site, repeated, Clock::Now());
+        }
+    }
+}
+
+bool ae::LogCallSite::Refresh(LogLevel level)
+{
+    const uint32_t generation = g_LogGeneration.load(std::memory_order_acquire);
+    const bool enabled = Logger::Get().IsLevelEnabled(level) || Logger::Get().IsLevelInBacktrace(level);
+
+    m_State.store((static_cast<uint64_t>(generation) << 8) | (static_cast<uint64_t>(level) << 1) |
+                      static_cast<uint64_t>(enabled),
+                  std::memory_order_relaxed);
+
+    return enabled;
+}
+
+void ae::Logger::WriteNewline(LogNewlineKind kind) const
+{
+    const auto sinks = m_SinkRegistry->Read();
+
+    for (const LogSinkSlot &slot : sinks->sinks)
+    {
+        if (kind == LogNewlineKind::ALL || (kind == LogNewlineKind::FILE) == slot.state->isFile)
+        {
+            CallSink(*slot.state, [&] { slot.state->WriteText("\n"); });
+        }
+    }
+}
+
+void ae::Logger::RunAsyncWorker()
+{
+    AsyncLogQueue &queue = *m_AsyncQueueStorage;
+    AsyncLogRecord record;
+    bool written = false; // Since the sinks were last flushed
+    t_OnAsyncWorker = true;
+
+    while (true)
+    {
+        // Read the stop flag before draining so nothing queued ahead of Close() is left behind
+        const bool stopRequested = m_AsyncStopRequested.load(std::memory_order_acquire);
+        bool drained = false;
+
+        {
+            while (queue.TryPop(record))
+            {
+                drained = true;
+
+                switch (record.kind)
+                {
+                case AsyncRecordKind::MESSAGE:
+                    if (record.decoder != nullptr)
+                    {
+                        record.text.clear();
+
+                        try
+                        {
+                            record.decoder(record.message.site->format, record.arguments.data(), record.text);
+                        }
+
+                        catch (const std::exception &e)
+                        {
+                            record.text = std::format("Failed to format deferred message '{}': {}",
+                                                      record.message.site->format, e.what());
+                        }
+                    }
+
+                    record.message.message = record.text;
+                    record.message.arguments = record.binaryArguments;
+                    record.message.fields = record.fields;
+
+                    // Sinks report their own exceptions, this only catches what fails around them
+                    try
+                    {
+                        WriteToSinks(record.message, record.sinkLevel);
+                    }
+
+                    catch (const std::exception &e)
+                    {
+                        static std::atomic<bool> reported{ false };
+
+                        if (!reported.exchange(true, std::memory_order_relaxed))
+                        {
+                            std::println(stderr, "Async log backend failed to write a message\nMessage: {}", e.what());
+                        }
+                    }
+                    break;
+                case AsyncRecordKind::NEWLINE:
+                    WriteNewline(record.newline);
+                    break;
+                case AsyncRecordKind::FLUSH:
+                    FlushStreams();
+
+                    // A marker evicted under DROP_OLDEST is requeued behind newer ones, never move backwards
+                    if (record.flushTicket > m_FlushCompleted.load(std::memory_order_relaxed))
+                    {
+                        m_FlushCompleted.store(record.flushTicket, std::memory_order_release);
+                    }
+
+                    m_FlushCompleted.notify_all();
+                    break;
+                case AsyncRecordKind::SKIPPED:
+                    break;
+                }
+            }
+        }
+
+        if (stopRequested)
+        {
+            break;
+        }
+
+        if (drained)
+        {
+            written = true;
+            continue;
+        }
+
+        // Out of messages, writing out what the sinks still buffer delays no one
+        if (written)
+        {
+            FlushStreams();
+            written = false;
+        }
+
+        // Parks until a producer or Close wakes it. Both of them change what is checked here before they look at the
+        // flag, and the flag is set before checking, so one side always sees the other.
+        m_AsyncWorkerParked.store(true, std::memory_order_seq_cst);
+
+        if (!m_AsyncStopRequested.load(std::memory_order_seq_cst) && queue.IsEmpty())
+        {
+            m_AsyncWorkerParked.wait(true, std::memory_order_acquire);
+        }
+
+        m_AsyncWorkerParked.store(false, std::memory_order_relaxed);
+    }
+}
+
+void ae::Logger::WriteCrashMarker(std::string_view marker) const
+{
+    // A read section could allocate its per-thread record, which is not allowed inside a signal handler
+    const LogSinkSnapshot *sinks = m_SinkRegistry->ReadUnguarded();
+
+    for (const LogSinkSlot &slot : sinks->sinks)
+    {
+        slot.state->WriteCrashMarker(marker);
+    }
+}
+
+void ae::Logger::PrintOpenMessage(const LogSinkState &state) const
+{
+    std::string text = std::format("{}\n", m_OpenMessage);
+
+    std::format_to(std::back_inserter(text), "\nExecution started at:\n{} {}\n", m_StartDate, m_StartTime);
+
+    std::format_to(std::back_inserter(text), "\nSink opened at:\n{} {}\n", DateTime::DateAsString(),
+                   DateTime::TimeAsString());
+
+    if (std::expected<std::string, TimeZoneError> tz = DateTime::TimeZoneAsString())
+    {
+        std::format_to(std::back_inserter(text), "\nTime zone: {}\n\n", *tz);
+    }
+
+    else
+    {
+        std::format_to(std::back_inserter(text), "\nUnknown time zone ({})\n\n", to_string(tz.error()));
+    }
+
+    state.WriteText(text);
+}
+
+void ae::Logger::PrintCloseMessage(const LogSinkState &state) const
+{
+    state.WriteText(
+        std::format("\nSink closed at:\n{} {}\n", DateTime::DateAsString(), DateTime::TimeAsString()));
+}
+
+void ae::Logger::PrintTerminationMessage(const LogSinkState &state) const
+{
+    std::string text =
+        std::format("\nClosed by termination at:\n{} {}\n", DateTime::DateAsString(), DateTime::TimeAsString());
+
+    std::format_to(std::back_inserter(text), "\nExecution time: {} s\n", m_ExecutionTimer.GetElapsedTimeAsString(3));
 
-    std::println(stream, "\nExecution time: {} s", m_ExecutionTimer.GetElapsedTimeAsString(3));
+    state.WriteText(text);
 }
@@ -0,0 +1,65 @@
+#include "general/pch.h"
+
+#include "async/AsyncLogQueue.h"
+
+#include <algorithm>
+#include <bit>
+
+ae::AsyncLogQueue::AsyncLogQueue(size_t capacity)
+    : m_Cells(std::make_unique<Cell[]>(std::bit_ceil(std::max<size_t>(capacity, 2)))),
+      m_Mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1), m_EnqueuePos(0), m_DequeuePos(0)
+{
+    for (size_t i = 0; i <= m_Mask; ++i)
+    {
+        m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+ae::AsyncLogQueue::Cell *ae::AsyncLogQueue::Claim(std::atomic<size_t> &cursor, size_t lag, size_t &pos)
+{
+    // Producers own a cell when its sequence equals the cursor, consumers when it equals the cursor + 1
+    pos = cursor.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        Cell *cell = &m_Cells[pos & m_Mask];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + lag);
+
+        if (diff == 0)
+        {
+            // Sequentially consistent so a producer's claim and its check for a parked consumer can not pass the
+            // consumer parking, see Logger::RunAsyncWorker
+            if (cursor.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return cell;
+            }
+        }
+
+        else if (diff < 0)
+        {
+            return nullptr;
+        }
+
+        else
+        {
+            pos = cursor.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool ae::AsyncLogQueue::TryPop(AsyncLogRecord &record)
+{
+    size_t pos = 0;
+    Cell *cell = Claim(m_DequeuePos, 1, pos);
+
+    if (cell == nullptr)
+    {
+        return false; // Empty
+    }
+
+    std::swap(record, cell->record);
+    cell->sequence.store(pos + m_Mask + 1, std::memory_order_release);
+
+    return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Log.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ae
+{
+enum class AsyncRecordKind : uint8_t
+{
+    MESSAGE = 0,
+    NEWLINE,
+    FLUSH,
+    SKIPPED, // The producer failed while writing the record, the backend passes over it
+};
+
+struct AsyncLogRecord
+{
+    AsyncRecordKind kind = AsyncRecordKind::MESSAGE;
+    LogNewlineKind newline = LogNewlineKind::ALL;
+    uint64_t flushTicket = 0;
+    LogMessage message{};
+    LogLevel sinkLevel = LogLevel::TRACE; // Differs from the message level for a backtrace, see Logger::WriteToSinks
+
+    // Owned copy of message.message, which only borrows the caller's buffer. Keeps its capacity as the cell is
+    // reused, so copying a message in does not allocate once the queue has warmed up.
+    std::string text;
+
+    // Set for deferred messages, text is then produced by the backend from the raw arguments
+    DeferredDecodeFn decoder = nullptr;
+    std::vector<std::byte> arguments;
+
+    // Owned copy of message.arguments, the backend points message.arguments here before writing
+    std::vector<std::byte> binaryArguments;
+
+    // Owned copy of message.fields, handled the same way
+    std::vector<std::byte> fields;
+};
+
+// Bounded multi-producer multi-consumer ring (Vyukov). Each cell carries a sequence number that tells producers and
+// consumers whose turn it is, so both sides only need one CAS on their own cursor. The Logger has a single consumer,
+// the extra consumer side is what lets a producer evict the oldest record under AsyncOverflowPolicy::DROP_OLDEST.
+class AsyncLogQueue
+{
+  public:
+    explicit AsyncLogQueue(size_t capacity);
+    ~AsyncLogQueue() = default;
+
+    AsyncLogQueue(const AsyncLogQueue &) = delete;
+    AsyncLogQueue(AsyncLogQueue &&) = delete;
+    AsyncLogQueue &operator=(const AsyncLogQueue &) = delete;
+    AsyncLogQueue &operator=(AsyncLogQueue &&) = delete;
+
+    // Claims a free cell and lets write fill the record already living there, so buffers owned by the cell are reused.
+    // A claimed cell is always published, if write throws the record is marked SKIPPED and the exception passed on.
+    template <class Writer> [[nodiscard]] inline bool TryPush(Writer &&write)
+    {
+        size_t pos = 0;
+        Cell *cell = Claim(m_EnqueuePos, 0, pos);
+
+        if (cell == nullptr)
+        {
+            return false; // Full
+        }
+
+        // Without publishing, the consumer could never get past the cell again
+        struct Publish
+        {
+            Cell *cell;
+            size_t pos;
+
+            ~Publish()
+            {
+                cell->sequence.store(pos + 1, std::memory_order_release);
+            }
+        } publish{ cell, pos };
+
+        try
+        {
+            write(cell->record);
+        }
+
+        catch (...)
+        {
+            cell->record.kind = AsyncRecordKind::SKIPPED;
+            throw;
+        }
+
+        return true;
+    }
+
+    // Swaps the oldest record with the given one, handing the caller's buffers back to the ring
+    [[nodiscard]] bool TryPop(AsyncLogRecord &record);
+
+    // False as soon as a producer has claimed a cell, before it has finished writing the record. Ordered after the
+    // caller's earlier sequentially consistent stores, see Logger::RunAsyncWorker.
+    [[nodiscard]] inline bool IsEmpty() const
+    {
+        return m_EnqueuePos.load(std::memory_order_seq_cst) == m_DequeuePos.load(std::memory_order_seq_cst);
+    }
+
+    [[nodiscard]] inline size_t GetCapacity() const
+    {
+        return m_Mask + 1;
+    }
+
+  private:
+    struct Cell;
+
+    Cell *Claim(std::atomic<size_t> &cursor, size_t lag, size_t &pos);
+
+  private:
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> sequence;
+        AsyncLogRecord record;
+    };
+
+    std::unique_ptr<Cell[]> m_Cells;
+    size_t m_Mask;
+
+    alignas(64) std::atomic<size_t> m_EnqueuePos;
+    alignas(64) std::atomic<size_t> m_DequeuePos;
+};
+} // namespace ae
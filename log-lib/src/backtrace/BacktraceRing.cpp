@@ -0,0 +1,61 @@
+#include "general/pch.h"
+
+#include "backtrace/BacktraceRing.h"
+
+ae::BacktraceRing::BacktraceRing() : m_Next(0), m_Count(0), m_Draining(false)
+{
+}
+
+void ae::BacktraceRing::Push(size_t capacity, const LogMessage &message, DeferredDecodeFn decoder,
+                             std::span<const std::byte> arguments)
+{
+    if (capacity == 0 || m_Draining)
+    {
+        return;
+    }
+
+    // The capacity only changes through Logger::EnableBacktrace, what was held before is given up
+    if (m_Slots.size() != capacity)
+    {
+        m_Slots.clear();
+        m_Slots.resize(capacity);
+        m_Next = 0;
+        m_Count = 0;
+    }
+
+    Slot &slot = m_Slots[m_Next];
+    slot.message = message;
+    slot.decoder = decoder;
+
+    if (decoder != nullptr)
+    {
+        slot.arguments.assign(arguments.begin(), arguments.end());
+        slot.text.clear();
+    }
+
+    else
+    {
+        slot.text.assign(message.message);
+    }
+
+    slot.fields.assign(message.fields.begin(), message.fields.end());
+
+    m_Next = (m_Next + 1) % m_Slots.size();
+    m_Count = std::min(m_Count + 1, m_Slots.size());
+}
+
+const ae::LogMessage &ae::BacktraceRing::Resolve(Slot &slot)
+{
+    if (slot.decoder != nullptr)
+    {
+        slot.decoder(slot.message.site->format, slot.arguments.data(), slot.text);
+        slot.decoder = nullptr;
+    }
+
+    // Binary sinks store the text instead, the typed arguments were never encoded
+    slot.message.message = slot.text;
+    slot.message.arguments = {};
+    slot.message.fields = slot.fields;
+
+    return slot.message;
+}
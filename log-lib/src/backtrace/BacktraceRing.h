@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Log.h"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ae
+{
+// The messages of one thread that no sink took, see Logger::EnableBacktrace. Slots keep their buffers when they are
+// overwritten, so pushing only copies bytes once the ring has gone around.
+class BacktraceRing
+{
+  public:
+    BacktraceRing();
+    ~BacktraceRing() = default;
+
+    // Overwrites the oldest message once capacity messages are held. A message with a decoder keeps its raw
+    // arguments and is only formatted if it is ever written.
+    void Push(size_t capacity, const LogMessage &message, DeferredDecodeFn decoder,
+              std::span<const std::byte> arguments);
+
+    // Calls write with every held message, oldest first, and empties the ring. Messages are only valid during the
+    // call.
+    template <class Write> inline void Drain(Write &&write)
+    {
+        // Messages logged by write itself, such as a load shedding notice, are neither kept nor trigger another drain
+        const size_t count = std::exchange(m_Count, 0);
+        m_Draining = true;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Slot &slot = m_Slots[(m_Next + m_Slots.size() - count + i) % m_Slots.size()];
+            write(Resolve(slot));
+        }
+
+        m_Draining = false;
+    }
+
+    [[nodiscard]] inline bool IsEmpty() const
+    {
+        return m_Count == 0;
+    }
+
+  private:
+    struct Slot
+    {
+        LogMessage message{};
+        std::string text;
+        DeferredDecodeFn decoder = nullptr;
+        std::vector<std::byte> arguments;
+        std::vector<std::byte> fields;
+    };
+
+    // Formats a deferred message and points the message at the slot's own buffers
+    const LogMessage &Resolve(Slot &slot);
+
+  private:
+    std::vector<Slot> m_Slots;
+    size_t m_Next;
+    size_t m_Count;
+    bool m_Draining;
+};
+} // namespace ae
@@ -0,0 +1,103 @@
+#include "general/pch.h"
+
+#include "binary/BinaryArgs.h"
+#include "binary/BinaryLogFormat.h"
+
+bool ae::ByteReader::Varint(uint64_t &value)
+{
+    value = 0;
+
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t byte = 0;
+
+        if (!Byte(byte))
+        {
+            return false;
+        }
+
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+
+    AE_THROW_RUNTIME_ERROR("Malformed varint in binary log");
+}
+
+void ae::DecodeBinaryArgs(std::string_view arguments, std::vector<BinaryValue> &values)
+{
+    ByteReader reader{ arguments.data(), arguments.data() + arguments.size() };
+    values.clear();
+
+    uint8_t count = 0;
+    bool complete = reader.Byte(count);
+
+    for (uint8_t i = 0; complete && i < count; ++i)
+    {
+        uint8_t kind = 0;
+        uint64_t integer = 0;
+        complete = reader.Byte(kind);
+
+        switch (static_cast<BinaryArgKind>(kind))
+        {
+        case BinaryArgKind::INT:
+            complete = complete && reader.Varint(integer);
+            values.emplace_back(ZigzagDecode(integer));
+            break;
+        case BinaryArgKind::UINT:
+            complete = complete && reader.Varint(integer);
+            values.emplace_back(integer);
+            break;
+        case BinaryArgKind::FLOAT:
+        {
+            float value = 0.0f;
+            complete = complete && reader.Fixed(value);
+            values.emplace_back(value);
+            break;
+        }
+        case BinaryArgKind::DOUBLE:
+        {
+            double value = 0.0;
+            complete = complete && reader.Fixed(value);
+            values.emplace_back(value);
+            break;
+        }
+        case BinaryArgKind::BOOL:
+        {
+            // Read as a byte, a corrupt or foreign file may hold something other than 0 or 1
+            uint8_t value = 0;
+            complete = complete && reader.Fixed(value);
+            values.emplace_back(value != 0);
+            break;
+        }
+        case BinaryArgKind::CHAR:
+        {
+            char value = 0;
+            complete = complete && reader.Fixed(value);
+            values.emplace_back(value);
+            break;
+        }
+        case BinaryArgKind::STRING:
+        {
+            std::string_view value;
+            complete = complete && reader.String(value);
+            values.emplace_back(value);
+            break;
+        }
+        case BinaryArgKind::POINTER:
+            complete = complete && reader.Varint(integer);
+            values.emplace_back(reinterpret_cast<const void *>(static_cast<uintptr_t>(integer)));
+            break;
+        default:
+            AE_THROW_RUNTIME_ERROR("Unknown argument kind {} in binary log", kind);
+        }
+    }
+
+    if (!complete)
+    {
+        AE_THROW_RUNTIME_ERROR("Truncated arguments in binary log");
+    }
+}
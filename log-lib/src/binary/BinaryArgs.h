@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Log.h"
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace ae
+{
+// One argument written by EncodeBinaryArg. Strings point into the encoded bytes.
+using BinaryValue = std::variant<int64_t, uint64_t, float, double, bool, char, std::string_view, const void *>;
+
+// Reads from undecoded bytes, every read returns false instead of running past the end
+struct ByteReader
+{
+    const char *pos;
+    const char *end;
+
+    inline bool Byte(uint8_t &value)
+    {
+        if (pos == end)
+        {
+            return false;
+        }
+
+        value = static_cast<uint8_t>(*pos++);
+        return true;
+    }
+
+    // Throws RuntimeError on a varint longer than 64 bits
+    bool Varint(uint64_t &value);
+
+    inline bool Bytes(size_t size, std::string_view &value)
+    {
+        if (static_cast<size_t>(end - pos) < size)
+        {
+            return false;
+        }
+
+        value = { pos, size };
+        pos += size;
+        return true;
+    }
+
+    inline bool String(std::string_view &value)
+    {
+        uint64_t size = 0;
+        return Varint(size) && Bytes(static_cast<size_t>(size), value);
+    }
+
+    template <class T> inline bool Fixed(T &value)
+    {
+        std::string_view bytes;
+
+        if (!Bytes(sizeof(T), bytes))
+        {
+            return false;
+        }
+
+        std::memcpy(&value, bytes.data(), sizeof(T));
+        return true;
+    }
+};
+
+// Replaces values with the output of EncodeBinaryArgs or EncodeLogFields. Throws RuntimeError on malformed input.
+void DecodeBinaryArgs(std::string_view arguments, std::vector<BinaryValue> &values);
+
+inline std::string_view AsChars(std::span<const std::byte> bytes)
+{
+    return { reinterpret_cast<const char *>(bytes.data()), bytes.size() };
+}
+} // namespace ae
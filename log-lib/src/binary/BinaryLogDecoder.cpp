@@ -0,0 +1,271 @@
+#include "general/pch.h"
+
+#include "binary/BinaryArgs.h"
+#include "binary/BinaryLogFormat.h"
+#include "sinks/LogLines.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace
+{
+using ae::BinaryValue;
+
+const BinaryValue &GetArgument(const std::vector<BinaryValue> &values, std::string_view id, size_t &nextIndex)
+{
+    size_t index = nextIndex;
+
+    if (id.empty())
+    {
+        ++nextIndex;
+    }
+
+    else if (std::from_chars(id.data(), id.data() + id.size(), index).ec != std::errc())
+    {
+        AE_THROW_RUNTIME_ERROR("Unsupported argument id '{}' in binary log format string", id);
+    }
+
+    if (index >= values.size())
+    {
+        AE_THROW_RUNTIME_ERROR("Binary log format string refers to missing argument {}", index);
+    }
+
+    return values[index];
+}
+
+// std::format needs the argument types at compile time, so each replacement field is formatted on its own. Nested
+// width and precision fields are replaced by the value of the argument they refer to first.
+void FormatBinaryMessage(std::string &out, std::string_view fmt, const std::vector<BinaryValue> &values)
+{
+    size_t nextIndex = 0;
+
+    for (size_t i = 0; i < fmt.size(); ++i)
+    {
+        const char c = fmt[i];
+
+        if ((c == '{' || c == '}') && i + 1 < fmt.size() && fmt[i + 1] == c)
+        {
+            out.push_back(c);
+            ++i;
+            continue;
+        }
+
+        if (c != '{')
+        {
+            out.push_back(c);
+            continue;
+        }
+
+        size_t close = i + 1;
+
+        for (int32_t depth = 1; close < fmt.size(); ++close)
+        {
+            depth += fmt[close] == '{' ? 1 : (fmt[close] == '}' ? -1 : 0);
+
+            if (depth == 0)
+            {
+                break;
+            }
+        }
+
+        if (close >= fmt.size())
+        {
+            AE_THROW_RUNTIME_ERROR("Unterminated replacement field in binary log format string");
+        }
+
+        const std::string_view field = fmt.substr(i + 1, close - i - 1);
+        const size_t colon = field.find(':');
+        const BinaryValue &value = GetArgument(values, field.substr(0, colon), nextIndex);
+
+        std::string spec = "{";
+
+        if (colon != std::string_view::npos)
+        {
+            spec.push_back(':');
+
+            for (size_t j = colon + 1; j < field.size(); ++j)
+            {
+                if (field[j] != '{')
+                {
+                    spec.push_back(field[j]);
+                    continue;
+                }
+
+                const size_t nestedClose = field.find('}', j);
+
+                if (nestedClose == std::string_view::npos)
+                {
+                    AE_THROW_RUNTIME_ERROR("Unterminated nested field in binary log format string");
+                }
+
+                const BinaryValue &nested = GetArgument(values, field.substr(j + 1, nestedClose - j - 1), nextIndex);
+
+                std::visit(
+                    [&spec](const auto &number)
+                    {
+                        if constexpr (std::is_integral_v<std::remove_cvref_t<decltype(number)>>)
+                        {
+                            std::format_to(std::back_inserter(spec), "{}", number);
+                        }
+
+                        else
+                        {
+                            AE_THROW_RUNTIME_ERROR("Dynamic width or precision in binary log is not an integer");
+                        }
+                    },
+                    nested);
+
+                j = nestedClose;
+            }
+        }
+
+        spec.push_back('}');
+
+        std::visit([&](const auto &argument)
+                   { std::vformat_to(std::back_inserter(out), spec, std::make_format_args(argument)); },
+                   value);
+
+        i = close;
+    }
+}
+} // namespace
+
+ae::BinaryLogDecoder::BinaryLogDecoder() : m_Offset(0), m_HeaderRead(false), m_LastTime(0)
+{
+}
+
+void ae::BinaryLogDecoder::Feed(std::string_view data, std::string &out)
+{
+    m_Pending.append(data);
+
+    while (DecodeRecord(out))
+    {
+    }
+
+    m_Pending.erase(0, m_Offset);
+    m_Offset = 0;
+}
+
+bool ae::BinaryLogDecoder::DecodeRecord(std::string &out)
+{
+    ByteReader reader{ m_Pending.data() + m_Offset, m_Pending.data() + m_Pending.size() };
+
+    if (!m_HeaderRead)
+    {
+        std::string_view header;
+
+        if (!reader.Bytes(c_BinaryLogHeaderSize, header))
+        {
+            return false;
+        }
+
+        uint32_t version = 0;
+        std::memcpy(&version, header.data() + sizeof(c_BinaryLogMagic), sizeof(version));
+
+        if (std::memcmp(header.data(), c_BinaryLogMagic, sizeof(c_BinaryLogMagic)) != 0 ||
+            version != c_BinaryLogVersion)
+        {
+            AE_THROW_RUNTIME_ERROR("Input is not a binary log of version {}", c_BinaryLogVersion);
+        }
+
+        std::memcpy(&m_LastTime, header.data() + sizeof(c_BinaryLogMagic) + sizeof(version), sizeof(m_LastTime));
+        m_HeaderRead = true;
+        m_Offset += c_BinaryLogHeaderSize;
+        return true;
+    }
+
+    uint8_t kind = 0;
+
+    if (!reader.Byte(kind))
+    {
+        return false;
+    }
+
+    switch (static_cast<BinaryRecordKind>(kind))
+    {
+    case BinaryRecordKind::SITE:
+    {
+        uint64_t index = 0;
+        uint8_t level = 0;
+        uint64_t line = 0;
+        std::string_view file;
+        std::string_view function;
+        std::string_view format;
+
+        if (!reader.Varint(index) || !reader.Byte(level) || !reader.Varint(line) || !reader.String(file) ||
+            !reader.String(function) || !reader.String(format))
+        {
+            return false;
+        }
+
+        if (index != m_Sites.size() || level > static_cast<uint8_t>(LogLevel::FATAL))
+        {
+            AE_THROW_RUNTIME_ERROR("Malformed call site {} in binary log", index);
+        }
+
+        m_Sites.push_back(Site{ .level = static_cast<LogLevel>(level),
+                                .line = static_cast<uint32_t>(line),
+                                .file = std::string(file),
+                                .function = std::string(function),
+                                .format = std::string(format) });
+        break;
+    }
+    case BinaryRecordKind::MESSAGE:
+    case BinaryRecordKind::TEXT:
+    {
+        uint64_t index = 0;
+        uint64_t delta = 0;
+        std::string_view payload;
+
+        if (!reader.Varint(index) || !reader.Varint(delta) || !reader.String(payload))
+        {
+            return false;
+        }
+
+        if (index >= m_Sites.size())
+        {
+            AE_THROW_RUNTIME_ERROR("Message refers to unknown call site {} in binary log", index);
+        }
+
+        const Site &site = m_Sites[index];
+        m_LastTime += ZigzagDecode(delta);
+
+        const std::chrono::system_clock::time_point time(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(m_LastTime)));
+
+        std::string message;
+
+        if (static_cast<BinaryRecordKind>(kind) == BinaryRecordKind::MESSAGE)
+        {
+            thread_local std::vector<BinaryValue> values;
+            DecodeBinaryArgs(payload, values);
+            FormatBinaryMessage(message, site.format, values);
+        }
+
+        else
+        {
+            message = payload;
+        }
+
+        AppendFileLine(out, DateTime::LogTimeAsString(time), site.level, site.file, site.line, message);
+        break;
+    }
+    case BinaryRecordKind::RAW:
+    {
+        std::string_view text;
+
+        if (!reader.String(text))
+        {
+            return false;
+        }
+
+        out.append(text);
+        break;
+    }
+    default:
+        AE_THROW_RUNTIME_ERROR("Unknown record kind {} in binary log", kind);
+    }
+
+    m_Offset = static_cast<size_t>(reader.pos - m_Pending.data());
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Layout of a binary log file, all integers little endian:
+//
+//   Header   magic[8] version:u32 startTime:i64 (nanoseconds since the epoch)
+//   SITE     kind index:varint level:u8 line:varint file:str function:str format:str
+//   MESSAGE  kind site:varint timeDelta:zigzag size:varint arguments[size] (see EncodeBinaryArgs)
+//   TEXT     kind site:varint timeDelta:zigzag message:str
+//   RAW      kind text:str
+//
+// A str is a varint length followed by the characters. Sites are numbered in the order they are first written, and
+// the time of each message is relative to the one before it in the file.
+namespace ae
+{
+constexpr char c_BinaryLogMagic[8] = { 'A', 'E', 'L', 'O', 'G', 'B', 'I', 'N' };
+constexpr uint32_t c_BinaryLogVersion = 1;
+constexpr size_t c_BinaryLogHeaderSize = sizeof(c_BinaryLogMagic) + sizeof(uint32_t) + sizeof(int64_t);
+
+enum class BinaryRecordKind : uint8_t
+{
+    SITE = 1,
+    MESSAGE,
+    TEXT, // A message whose arguments could not be encoded, stored as formatted text
+    RAW,  // Text outside of messages, such as the open message and newlines
+};
+
+constexpr uint64_t ZigzagEncode(int64_t value) noexcept
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+constexpr int64_t ZigzagDecode(uint64_t value) noexcept
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+} // namespace ae
@@ -0,0 +1,204 @@
+#include "general/pch.h"
+
+#include "crash/CrashHandler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+
+#ifdef AE_WINDOWS
+#include <io.h>
+#endif // AE_WINDOWS
+
+namespace
+{
+struct FatalSignal
+{
+    int number;
+    std::string_view marker;
+};
+
+#ifdef AE_WINDOWS
+constexpr std::array<FatalSignal, 4> c_FatalSignals = { {
+    { SIGSEGV, "\nClosed by signal SIGSEGV\n" },
+    { SIGABRT, "\nClosed by signal SIGABRT\n" },
+    { SIGFPE, "\nClosed by signal SIGFPE\n" },
+    { SIGILL, "\nClosed by signal SIGILL\n" },
+} };
+
+using PreviousHandler = void (*)(int);
+#else
+constexpr std::array<FatalSignal, 5> c_FatalSignals = { {
+    { SIGSEGV, "\nClosed by signal SIGSEGV\n" },
+    { SIGABRT, "\nClosed by signal SIGABRT\n" },
+    { SIGBUS, "\nClosed by signal SIGBUS\n" },
+    { SIGFPE, "\nClosed by signal SIGFPE\n" },
+    { SIGILL, "\nClosed by signal SIGILL\n" },
+} };
+
+using PreviousHandler = struct sigaction;
+#endif // AE_WINDOWS
+
+constexpr std::string_view c_TerminateMarker = "\nClosed by std::terminate\n";
+
+std::atomic<ae::CrashWriter> g_CrashWriter{ nullptr };
+std::atomic<void *> g_CrashContext{ nullptr };
+std::atomic<bool> g_CrashHandlersInstalled{ false };
+std::atomic<bool> g_Crashed{ false };
+std::array<PreviousHandler, c_FatalSignals.size()> g_PreviousHandlers{};
+std::terminate_handler g_PreviousTerminate = nullptr;
+
+void WriteCrashMarker(std::string_view marker)
+{
+    // std::terminate ends in abort() and a crash inside the writer raises again, only the first one writes
+    if (g_Crashed.exchange(true))
+    {
+        return;
+    }
+
+    if (const ae::CrashWriter writer = g_CrashWriter.load())
+    {
+        writer(g_CrashContext.load(), marker);
+    }
+}
+
+#ifdef AE_WINDOWS
+void HandleSignal(int signal)
+#else
+void HandleSignal(int signal, siginfo_t *info, void *context)
+#endif // AE_WINDOWS
+{
+    const int savedErrno = errno;
+
+    for (size_t i = 0; i < c_FatalSignals.size(); ++i)
+    {
+        if (c_FatalSignals[i].number != signal)
+        {
+            continue;
+        }
+
+        WriteCrashMarker(c_FatalSignals[i].marker);
+
+#ifndef AE_WINDOWS
+        // A handler that wants siginfo, such as a crash reporter, gets the original fault address and context instead
+        // of those of a raised signal. If it returns the fault repeats, or abort raises again, and this handler chains
+        // on once more without writing.
+        const struct sigaction &previous = g_PreviousHandlers[i];
+
+        if ((previous.sa_flags & SA_SIGINFO) != 0 && previous.sa_sigaction != nullptr)
+        {
+            previous.sa_sigaction(signal, info, context);
+            break;
+        }
+#endif // AE_WINDOWS
+
+        // With the previous handler back in place the signal ends the process the way it would have without the
+        // logger. It stays blocked until this handler returns.
+#ifdef AE_WINDOWS
+        std::signal(signal, g_PreviousHandlers[i]);
+#else
+        ::sigaction(signal, &g_PreviousHandlers[i], nullptr);
+#endif // AE_WINDOWS
+        std::raise(signal);
+        break;
+    }
+
+    errno = savedErrno;
+}
+
+[[noreturn]] void HandleTerminate()
+{
+    WriteCrashMarker(c_TerminateMarker);
+
+    if (g_PreviousTerminate != nullptr)
+    {
+        g_PreviousTerminate();
+    }
+
+    std::abort();
+}
+} // namespace
+
+void ae::InstallCrashHandlers(CrashWriter writer, void *context)
+{
+    // Without a writer while the context changes, a crash in between skips writing rather than using the wrong one
+    g_CrashWriter.store(nullptr);
+    g_CrashContext.store(context);
+    g_CrashWriter.store(writer);
+
+    // Installing twice would make the handlers chain to themselves
+    if (g_CrashHandlersInstalled.exchange(true))
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < c_FatalSignals.size(); ++i)
+    {
+#ifdef AE_WINDOWS
+        g_PreviousHandlers[i] = std::signal(c_FatalSignals[i].number, &HandleSignal);
+#else
+        struct sigaction action{};
+        action.sa_sigaction = &HandleSignal;
+        sigemptyset(&action.sa_mask);
+        // Threads with an alternate signal stack can still log a stack overflow. SA_SIGINFO keeps the fault's siginfo
+        // for a previous handler that wants it.
+        action.sa_flags = SA_ONSTACK | SA_SIGINFO;
+
+        ::sigaction(c_FatalSignals[i].number, &action, &g_PreviousHandlers[i]);
+#endif // AE_WINDOWS
+    }
+
+    g_PreviousTerminate = std::set_terminate(&HandleTerminate);
+}
+
+void ae::RemoveCrashWriter(void *context)
+{
+    if (g_CrashContext.load() == context)
+    {
+        g_CrashWriter.store(nullptr);
+    }
+}
+
+void ae::WriteOnCrash(int descriptor, std::string_view text)
+{
+    while (!text.empty())
+    {
+#ifdef AE_WINDOWS
+        const int written =
+            _write(descriptor, text.data(), static_cast<unsigned int>(std::min<size_t>(text.size(), INT_MAX)));
+#else
+        const ssize_t written = ::write(descriptor, text.data(), text.size());
+
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+#endif // AE_WINDOWS
+
+        if (written <= 0)
+        {
+            return;
+        }
+
+        text.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+void ae::WriteStreamBufferOnCrash([[maybe_unused]] FILE *stream)
+{
+#ifdef __GLIBC__
+    const char *begin = stream->_IO_write_base;
+    const char *end = stream->_IO_write_ptr;
+
+    if (begin != nullptr && end > begin)
+    {
+        WriteOnCrash(stream->_fileno, std::string_view(begin, static_cast<size_t>(end - begin)));
+
+        // Not written a second time should a chained handler let the process live on
+        stream->_IO_write_ptr = stream->_IO_write_base;
+    }
+#endif // __GLIBC__
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdio>
+#include <string_view>
+
+namespace ae
+{
+// Called once by the first fatal signal or std::terminate with the context it was installed with and a fixed marker
+// naming the cause. Runs inside a signal handler, so it may only use async-signal-safe functions.
+typedef void (*CrashWriter)(void *context, std::string_view marker);
+
+// Installs handlers for the fatal signals and std::terminate that call writer and then hand the crash on to what was
+// installed before them. Installing again only replaces the writer and context.
+void InstallCrashHandlers(CrashWriter writer, void *context);
+// Stops calling the writer if it was installed with context, for an owner that is about to be destroyed. The
+// handlers stay in place and only chain on.
+void RemoveCrashWriter(void *context);
+
+// Writes all of text with write(2), gives up on the first error. Async-signal-safe.
+void WriteOnCrash(int descriptor, std::string_view text);
+
+// Writes out what stream holds in its buffer without locking it. Only glibc makes the buffer reachable, elsewhere the
+// buffered text is lost.
+void WriteStreamBufferOnCrash(FILE *stream);
+} // namespace ae
@@ -1 +1,47 @@
 #include "general/pch.h"
+
+ae::ErrorMessage::ErrorMessage(const char *type, std::source_location loc, std::string_view fmt, std::format_args args)
+    : m_State(std::make_shared<State>(type, loc, std::string_view{}))
+{
+    std::vformat_to(std::back_inserter(m_State->content), fmt, args);
+}
+
+const char *ae::ErrorMessage::Get() const noexcept
+{
+    // Only a moved from exception has no state
+    if (m_State == nullptr)
+    {
+        return "";
+    }
+
+    State &state = *m_State;
+
+    std::call_once(state.built,
+                   [&state]()
+                   {
+                       // Without memory for the text the type alone has to do
+                       state.text = state.type;
+
+                       try
+                       {
+                           if (state.decoder != nullptr)
+                           {
+                               state.decoder(state.fmt, state.arguments.data(), state.content);
+                           }
+
+                           state.message.reserve(255);
+
+                           std::format_to(std::back_inserter(state.message), "\n\n[{}]\n\nIn:\t{}:{} ({})\nWhat:\t{}\n",
+                                          state.type, GetFileName(std::string_view{ state.loc.file_name() }),
+                                          state.loc.line(), state.loc.function_name(), state.content);
+
+                           state.text = state.message.c_str();
+                       }
+
+                       catch (const std::exception &)
+                       {
+                       }
+                   });
+
+    return state.text;
+}
@@ -0,0 +1,253 @@
+#include "general/pch.h"
+
+#include "sinks/StructuredLines.h"
+
+#include <cstdio>
+#include <iterator>
+
+namespace
+{
+// A buffer of a thread that has exited is handed to the next new thread once its capture is over
+struct ProfileBufferSlot
+{
+    std::unique_ptr<ae::ProfileBuffer> buffer;
+    bool owned;
+};
+
+struct ProfileBufferRegistry
+{
+    std::mutex mutex;
+    std::vector<ProfileBufferSlot> slots;
+    size_t eventsPerThread = 0;
+    uint32_t nextThreadId = 1;
+};
+
+ProfileBufferRegistry &GetRegistry()
+{
+    // Never destroyed, threads that exit while statics are torn down still release their buffers
+    static ProfileBufferRegistry *registry = new ProfileBufferRegistry();
+    return *registry;
+}
+
+// Releases the calling thread's buffer when the thread exits
+struct ProfileBufferOwner
+{
+    ae::ProfileBuffer *buffer = nullptr;
+
+    ~ProfileBufferOwner()
+    {
+        if (buffer == nullptr)
+        {
+            return;
+        }
+
+        ProfileBufferRegistry &registry = GetRegistry();
+        std::scoped_lock lock(registry.mutex);
+
+        for (ProfileBufferSlot &slot : registry.slots)
+        {
+            if (slot.buffer.get() == buffer)
+            {
+                slot.owned = false;
+            }
+        }
+    }
+};
+
+constexpr size_t c_TraceFlushSize = 64 * 1024;
+
+int64_t ToNanos(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+// Microseconds with three decimals, the unit of the trace event format
+void AppendMicros(std::string &out, int64_t nanos)
+{
+    std::format_to(std::back_inserter(out), "{}.{:03}", nanos / 1000, nanos % 1000);
+}
+
+uint32_t GetProcessId()
+{
+#ifdef AE_WINDOWS
+    return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+    return static_cast<uint32_t>(getpid());
+#endif // AE_WINDOWS
+}
+} // namespace
+
+void ae::Profiler::Start(size_t eventsPerThread)
+{
+    ProfileBufferRegistry &registry = GetRegistry();
+
+    {
+        std::scoped_lock lock(registry.mutex);
+        registry.eventsPerThread = eventsPerThread;
+
+        // Each thread resets its own buffer on its next zone
+        g_ProfilerCapture.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    g_ProfilerEnabled.store(true, std::memory_order_relaxed);
+}
+
+void ae::Profiler::Stop()
+{
+    g_ProfilerEnabled.store(false, std::memory_order_relaxed);
+}
+
+uint64_t ae::Profiler::GetDroppedEventCount()
+{
+    ProfileBufferRegistry &registry = GetRegistry();
+    std::scoped_lock lock(registry.mutex);
+
+    const uint32_t capture = g_ProfilerCapture.load(std::memory_order_relaxed);
+    uint64_t dropped = 0;
+
+    for (const ProfileBufferSlot &slot : registry.slots)
+    {
+        if (slot.buffer->capture.load(std::memory_order_relaxed) == capture)
+        {
+            dropped += slot.buffer->dropped.load(std::memory_order_relaxed);
+        }
+    }
+
+    return dropped;
+}
+
+ae::ProfileBuffer *ae::Profiler::AttachBuffer()
+{
+    thread_local ProfileBufferOwner t_Owner;
+
+    ProfileBufferRegistry &registry = GetRegistry();
+    std::scoped_lock lock(registry.mutex);
+
+    const uint32_t capture = g_ProfilerCapture.load(std::memory_order_relaxed);
+    ProfileBuffer *buffer = t_Owner.buffer;
+
+    if (buffer == nullptr)
+    {
+        for (ProfileBufferSlot &slot : registry.slots)
+        {
+            if (!slot.owned && slot.buffer->capture.load(std::memory_order_relaxed) != capture)
+            {
+                slot.owned = true;
+                buffer = slot.buffer.get();
+                break;
+            }
+        }
+
+        if (buffer == nullptr)
+        {
+            registry.slots.push_back(ProfileBufferSlot{ .buffer = std::make_unique<ProfileBuffer>(), .owned = true });
+            buffer = registry.slots.back().buffer.get();
+        }
+
+        buffer->threadId = registry.nextThreadId++;
+        t_Owner.buffer = buffer;
+        GetProfileBuffer() = buffer;
+    }
+
+    // Under the lock, so WriteTrace never reads events that are being replaced
+    if (buffer->capacity != registry.eventsPerThread)
+    {
+        buffer->events = std::make_unique<ProfileEvent[]>(registry.eventsPerThread);
+        buffer->capacity = registry.eventsPerThread;
+    }
+
+    buffer->count.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+    buffer->capture.store(capture, std::memory_order_relaxed);
+
+    return buffer;
+}
+
+void ae::Profiler::WriteTrace(const std::string &path)
+{
+    FILE *file = nullptr;
+
+#ifdef AE_WINDOWS
+    errno_t res = fopen_s(&file, path.c_str(), "wb");
+
+    if (res != 0 || file == nullptr)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open trace file at '{}'. Error code: {}", path, res);
+    }
+#else
+    file = std::fopen(path.c_str(), "wb");
+
+    if (!file)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open trace file at '{}'", path);
+    }
+#endif
+
+    const uint32_t processId = GetProcessId();
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+
+    const auto separate = [&out, &first]()
+    {
+        if (!first)
+        {
+            out.push_back(',');
+        }
+
+        out.push_back('\n');
+        first = false;
+    };
+
+    ProfileBufferRegistry &registry = GetRegistry();
+
+    {
+        // Holding the lock keeps threads from starting a new capture in their buffers, appending goes on
+        std::scoped_lock lock(registry.mutex);
+        const uint32_t capture = g_ProfilerCapture.load(std::memory_order_relaxed);
+
+        for (const ProfileBufferSlot &slot : registry.slots)
+        {
+            const ProfileBuffer &buffer = *slot.buffer;
+
+            if (buffer.capture.load(std::memory_order_relaxed) != capture)
+            {
+                continue;
+            }
+
+            const size_t count = buffer.count.load(std::memory_order_acquire);
+
+            separate();
+            std::format_to(std::back_inserter(out),
+                           "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":\"Thread "
+                           "{}\"}}}}",
+                           processId, buffer.threadId, buffer.threadId);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const ProfileEvent &event = buffer.events[i];
+
+                separate();
+                out += "{\"name\":\"";
+                AppendJsonEscaped(out, event.zone->name);
+                out += "\",\"ph\":\"X\",\"ts\":";
+                AppendMicros(out, ToNanos(event.begin.time_since_epoch()));
+                out += ",\"dur\":";
+                AppendMicros(out, ToNanos(event.end - event.begin));
+                std::format_to(std::back_inserter(out), ",\"pid\":{},\"tid\":{},\"args\":{{\"file\":\"", processId,
+                               buffer.threadId);
+                AppendJsonEscaped(out, event.zone->file);
+                std::format_to(std::back_inserter(out), "\",\"line\":{}}}}}", event.zone->line);
+
+                if (out.size() >= c_TraceFlushSize)
+                {
+                    std::fwrite(out.data(), 1, out.size(), file);
+                    out.clear();
+                }
+            }
+        }
+    }
+
+    out += "\n]}\n";
+    std::fwrite(out.data(), 1, out.size(), file);
+    std::fclose(file);
+}
@@ -0,0 +1,124 @@
+#include "general/pch.h"
+
+#include "sinks/BinaryFileWriter.h"
+
+#include "binary/BinaryLogFormat.h"
+#include "crash/CrashHandler.h"
+
+#include <cstring>
+
+ae::BinaryFileWriter::BinaryFileWriter(const std::string &path)
+    : m_File(nullptr),
+      m_LastTime(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count())
+{
+#ifdef AE_WINDOWS
+    errno_t res = fopen_s(&m_File, path.c_str(), "wb");
+
+    if (res != 0 || m_File == nullptr)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open binary log file at '{}'. Error code: {}", path, res);
+    }
+#else
+    m_File = std::fopen(path.c_str(), "wb");
+
+    if (!m_File)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open binary log file at '{}'", path);
+    }
+#endif
+
+    std::array<char, c_BinaryLogHeaderSize> header{};
+    std::memcpy(header.data(), c_BinaryLogMagic, sizeof(c_BinaryLogMagic));
+    std::memcpy(header.data() + sizeof(c_BinaryLogMagic), &c_BinaryLogVersion, sizeof(c_BinaryLogVersion));
+    std::memcpy(header.data() + sizeof(c_BinaryLogMagic) + sizeof(c_BinaryLogVersion), &m_LastTime,
+                sizeof(m_LastTime));
+
+    std::fwrite(header.data(), 1, header.size(), m_File);
+}
+
+ae::BinaryFileWriter::~BinaryFileWriter()
+{
+    std::fclose(m_File);
+}
+
+size_t ae::BinaryFileWriter::Write(const LogMessage &message)
+{
+    const int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             Clock::ToSystemTime(message.time).time_since_epoch())
+                             .count();
+
+    std::scoped_lock lock(m_Mutex);
+    m_Record.clear();
+
+    const auto [site, added] = m_Sites.try_emplace(message.site, m_Sites.size());
+
+    if (added)
+    {
+        m_Record.push_back(static_cast<std::byte>(BinaryRecordKind::SITE));
+        AppendBinaryVarint(m_Record, site->second);
+        m_Record.push_back(static_cast<std::byte>(message.site->level));
+        AppendBinaryVarint(m_Record, message.site->line);
+        AppendString(message.site->file);
+        AppendString(message.site->function);
+        AppendString(message.site->format);
+    }
+
+    // Messages from several threads can arrive slightly out of order, so the delta is signed
+    const bool hasArguments = !message.arguments.empty();
+
+    m_Record.push_back(static_cast<std::byte>(hasArguments ? BinaryRecordKind::MESSAGE : BinaryRecordKind::TEXT));
+    AppendBinaryVarint(m_Record, site->second);
+    AppendBinaryVarint(m_Record, ZigzagEncode(time - m_LastTime));
+    m_LastTime = time;
+
+    if (hasArguments)
+    {
+        AppendBinaryVarint(m_Record, message.arguments.size());
+        m_Record.insert(m_Record.end(), message.arguments.begin(), message.arguments.end());
+    }
+
+    else
+    {
+        AppendString(message.message);
+    }
+
+    Submit();
+    return m_Record.size();
+}
+
+void ae::BinaryFileWriter::WriteText(std::string_view text)
+{
+    std::scoped_lock lock(m_Mutex);
+    m_Record.clear();
+
+    m_Record.push_back(static_cast<std::byte>(BinaryRecordKind::RAW));
+    AppendString(text);
+
+    Submit();
+}
+
+void ae::BinaryFileWriter::Flush()
+{
+    std::scoped_lock lock(m_Mutex);
+    std::fflush(m_File);
+}
+
+void ae::BinaryFileWriter::WriteBufferOnCrash()
+{
+    WriteStreamBufferOnCrash(m_File);
+}
+
+void ae::BinaryFileWriter::AppendString(std::string_view text)
+{
+    AppendBinaryVarint(m_Record, text.size());
+
+    const auto *data = reinterpret_cast<const std::byte *>(text.data());
+    m_Record.insert(m_Record.end(), data, data + text.size());
+}
+
+void ae::BinaryFileWriter::Submit()
+{
+    std::fwrite(m_Record.data(), 1, m_Record.size(), m_File);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Log.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ae
+{
+// Owns the file behind a binary file sink, see binary/BinaryLogFormat.h for the layout. Each call site is described
+// the first time one of its messages is written, after that messages refer to it by index.
+class BinaryFileWriter
+{
+  public:
+    // Throws FileOpenError if the file cannot be created
+    explicit BinaryFileWriter(const std::string &path);
+    ~BinaryFileWriter();
+
+    BinaryFileWriter(const BinaryFileWriter &) = delete;
+    BinaryFileWriter(BinaryFileWriter &&) = delete;
+    BinaryFileWriter &operator=(const BinaryFileWriter &) = delete;
+    BinaryFileWriter &operator=(BinaryFileWriter &&) = delete;
+
+    // Returns the size of the records written for the message
+    size_t Write(const LogMessage &message);
+    void WriteText(std::string_view text);
+    void Flush();
+    // Writes out the stdio buffer without the lock, only for the crash handler. The file may end in a partial
+    // record.
+    void WriteBufferOnCrash();
+
+  private:
+    // Callers hold m_Mutex
+    void AppendString(std::string_view text);
+    void Submit();
+
+  private:
+    std::mutex m_Mutex;
+    FILE *m_File;
+    int64_t m_LastTime;
+    std::unordered_map<const LogCallSiteInfo *, uint64_t> m_Sites;
+    std::vector<std::byte> m_Record;
+};
+} // namespace ae
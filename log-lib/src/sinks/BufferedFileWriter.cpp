@@ -0,0 +1,186 @@
+#include "general/pch.h"
+
+#include "sinks/BufferedFileWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#ifdef AE_WINDOWS
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#endif // AE_WINDOWS
+
+ae::BufferedFileWriter::BufferedFileWriter(const std::string &path, const LogFileBufferOptions &options)
+    : m_File(-1), m_Buffer(std::make_unique_for_overwrite<char[]>(std::max<size_t>(options.bufferSize, 1))),
+      m_Capacity(std::max<size_t>(options.bufferSize, 1)), m_Used(0),
+      m_FlushBytes(std::clamp<size_t>(options.flushBytes, 1, m_Capacity)),
+      m_FlushInterval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(options.flushInterval)),
+      m_FirstPending(), m_Failed(false)
+{
+#ifdef AE_WINDOWS
+    const errno_t res = _sopen_s(&m_File, path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY | _O_NOINHERIT,
+                                 _SH_DENYWR, _S_IREAD | _S_IWRITE);
+
+    if (res != 0 || m_File < 0)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open buffered log file at '{}'. Error code: {}", path, res);
+    }
+#else
+    m_File = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (m_File < 0)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open buffered log file at '{}'. Error: {}", path, std::strerror(errno));
+    }
+#endif // AE_WINDOWS
+}
+
+ae::BufferedFileWriter::~BufferedFileWriter()
+{
+    std::scoped_lock lock(m_Mutex);
+    WriteOut({});
+
+#ifdef AE_WINDOWS
+    _close(m_File);
+#else
+    ::close(m_File);
+#endif // AE_WINDOWS
+}
+
+void ae::BufferedFileWriter::Write(std::string_view text, bool flushNow)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    std::scoped_lock lock(m_Mutex);
+
+    if (m_Used == 0)
+    {
+        m_FirstPending = now;
+    }
+
+    if (text.size() > m_Capacity - m_Used)
+    {
+        WriteOut(text);
+        return;
+    }
+
+    std::memcpy(m_Buffer.get() + m_Used, text.data(), text.size());
+    m_Used += text.size();
+
+    if (flushNow || m_Used >= m_FlushBytes || now - m_FirstPending >= m_FlushInterval)
+    {
+        WriteOut({});
+    }
+}
+
+void ae::BufferedFileWriter::Flush(bool force)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    std::scoped_lock lock(m_Mutex);
+
+    if (m_Used != 0 && (force || now - m_FirstPending >= m_FlushInterval))
+    {
+        WriteOut({});
+    }
+}
+
+void ae::BufferedFileWriter::WriteCrashMarker(std::string_view marker)
+{
+    // WriteAll only makes system calls, which are async-signal-safe. A line another thread is copying in may be cut
+    // short.
+    if (WriteAll(std::string_view(m_Buffer.get(), m_Used), marker))
+    {
+        m_Used = 0;
+    }
+}
+
+void ae::BufferedFileWriter::WriteOut(std::string_view overflow)
+{
+    if (m_Used == 0 && overflow.empty())
+    {
+        return;
+    }
+
+    // A failing disk must not take the application down with it, report once and drop the batch
+    if (!WriteAll(std::string_view(m_Buffer.get(), m_Used), overflow) && !m_Failed)
+    {
+        m_Failed = true;
+        std::fputs("Failed to write buffered log file, pending lines were discarded\n", stderr);
+    }
+
+    m_Used = 0;
+}
+
+bool ae::BufferedFileWriter::WriteAll(std::string_view first, std::string_view second)
+{
+#ifdef AE_WINDOWS
+    for (std::string_view part : { first, second })
+    {
+        while (!part.empty())
+        {
+            const unsigned int chunk = static_cast<unsigned int>(std::min<size_t>(part.size(), INT_MAX));
+            const int written = _write(m_File, part.data(), chunk);
+
+            if (written < 0)
+            {
+                return false;
+            }
+
+            part.remove_prefix(static_cast<size_t>(written));
+        }
+    }
+
+    return true;
+#else
+    // Buffer and overflowing line go out in one system call, partial writes continue where the kernel stopped
+    iovec parts[2] = { { const_cast<char *>(first.data()), first.size() },
+                       { const_cast<char *>(second.data()), second.size() } };
+    iovec *part = parts;
+    int count = 2;
+
+    while (count > 0)
+    {
+        if (part->iov_len == 0)
+        {
+            ++part;
+            --count;
+            continue;
+        }
+
+        ssize_t written = ::writev(m_File, part, count);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        while (count > 0 && static_cast<size_t>(written) >= part->iov_len)
+        {
+            written -= static_cast<ssize_t>(part->iov_len);
+            ++part;
+            --count;
+        }
+
+        if (count > 0)
+        {
+            part->iov_base = static_cast<char *>(part->iov_base) + written;
+            part->iov_len -= static_cast<size_t>(written);
+        }
+    }
+
+    return true;
+#endif // AE_WINDOWS
+}
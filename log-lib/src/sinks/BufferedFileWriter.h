@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Log.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace ae
+{
+// Owns the file behind a buffered file sink. Lines are copied into one large buffer under a short lock and handed to
+// the OS in a single call once a threshold from LogFileBufferOptions is reached, a line that does not fit is written
+// together with the pending buffer instead of being split.
+class BufferedFileWriter
+{
+  public:
+    // Throws FileOpenError if the file cannot be created
+    BufferedFileWriter(const std::string &path, const LogFileBufferOptions &options);
+    ~BufferedFileWriter();
+
+    BufferedFileWriter(const BufferedFileWriter &) = delete;
+    BufferedFileWriter(BufferedFileWriter &&) = delete;
+    BufferedFileWriter &operator=(const BufferedFileWriter &) = delete;
+    BufferedFileWriter &operator=(BufferedFileWriter &&) = delete;
+
+    void Write(std::string_view text, bool flushNow);
+    // Without force only writes out if the oldest pending line has waited longer than the flush interval
+    void Flush(bool force);
+    // Writes the buffer and marker without the lock, only for the crash handler
+    void WriteCrashMarker(std::string_view marker);
+
+  private:
+    // Callers hold m_Mutex
+    void WriteOut(std::string_view overflow);
+    [[nodiscard]] bool WriteAll(std::string_view first, std::string_view second);
+
+  private:
+    std::mutex m_Mutex;
+    int m_File;
+    std::unique_ptr<char[]> m_Buffer;
+    size_t m_Capacity;
+    size_t m_Used;
+    size_t m_FlushBytes;
+    std::chrono::steady_clock::duration m_FlushInterval;
+    std::chrono::steady_clock::time_point m_FirstPending;
+    bool m_Failed;
+};
+} // namespace ae
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Log.h"
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace ae
+{
+constexpr std::array<std::string_view, 5> c_LevelLookup = { "TRACE", "INFO", "WARNING", "ERROR", "FATAL" };
+
+// The line layout shared by every file sink and the LogDecode tool
+inline void AppendFileLine(std::string &out, std::string_view time, LogLevel level, std::string_view file,
+                           uint32_t line, std::string_view message)
+{
+    std::format_to(std::back_inserter(out), "{} [{}] | {}:{} - {}\n", time, c_LevelLookup[static_cast<uint32_t>(level)],
+                   file, line, message);
+}
+} // namespace ae
@@ -0,0 +1,237 @@
+#include "general/pch.h"
+
+#include "sinks/RingFileWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifndef AE_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // AE_WINDOWS
+
+ae::RingFileWriter::RingFileWriter(const std::string &path, size_t capacity)
+    : m_Header(nullptr), m_Data(nullptr), m_Capacity(capacity), m_MappedSize(c_RingLogHeaderSize + capacity),
+#ifdef AE_WINDOWS
+      m_File(INVALID_HANDLE_VALUE), m_Mapping(nullptr)
+#else
+      m_File(-1)
+#endif // AE_WINDOWS
+{
+#ifdef AE_WINDOWS
+    m_File = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (m_File == INVALID_HANDLE_VALUE)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open ring log file at '{}'. Error code: {}", path, GetLastError());
+    }
+
+    LARGE_INTEGER size{};
+    LARGE_INTEGER target{};
+    target.QuadPart = static_cast<LONGLONG>(m_MappedSize);
+
+    // A file of another size is from a differently configured sink, start over with the new size
+    if (!GetFileSizeEx(m_File, &size) ||
+        (size.QuadPart != target.QuadPart &&
+         (!SetFilePointerEx(m_File, target, nullptr, FILE_BEGIN) || !SetEndOfFile(m_File))))
+    {
+        const DWORD error = GetLastError();
+        Close();
+        AE_THROW_FILE_OPEN_ERROR("Failed to size ring log file at '{}'. Error code: {}", path, error);
+    }
+
+    m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    void *view = m_Mapping != nullptr ? MapViewOfFile(m_Mapping, FILE_MAP_WRITE, 0, 0, m_MappedSize) : nullptr;
+
+    if (view == nullptr)
+    {
+        const DWORD error = GetLastError();
+        Close();
+        AE_THROW_FILE_OPEN_ERROR("Failed to map ring log file at '{}'. Error code: {}", path, error);
+    }
+#else
+    m_File = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (m_File < 0)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open ring log file at '{}'. Error: {}", path, std::strerror(errno));
+    }
+
+    struct stat info{};
+
+    if (::fstat(m_File, &info) != 0)
+    {
+        const int error = errno;
+        Close();
+        AE_THROW_FILE_OPEN_ERROR("Failed to inspect ring log file at '{}'. Error: {}", path, std::strerror(error));
+    }
+
+    // A file of another size is from a differently configured sink, start over with the new size. The blocks are
+    // reserved up front so a full disk shows up here rather than as a SIGBUS on some later write.
+    if (static_cast<size_t>(info.st_size) != m_MappedSize)
+    {
+        int error = ::ftruncate(m_File, 0) != 0 ? errno : 0;
+
+        if (error == 0)
+        {
+            error = ::posix_fallocate(m_File, 0, static_cast<off_t>(m_MappedSize));
+
+            // Not every file system can reserve blocks, fall back to a sparse file
+            if (error == EOPNOTSUPP || error == EINVAL)
+            {
+                error = ::ftruncate(m_File, static_cast<off_t>(m_MappedSize)) != 0 ? errno : 0;
+            }
+        }
+
+        if (error != 0)
+        {
+            Close();
+            AE_THROW_FILE_OPEN_ERROR("Failed to allocate ring log file at '{}'. Error: {}", path,
+                                     std::strerror(error));
+        }
+    }
+
+    void *view = ::mmap(nullptr, m_MappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+
+    if (view == MAP_FAILED)
+    {
+        const int error = errno;
+        Close();
+        AE_THROW_FILE_OPEN_ERROR("Failed to map ring log file at '{}'. Error: {}", path, std::strerror(error));
+    }
+#endif // AE_WINDOWS
+
+    m_Header = static_cast<RingLogFileHeader *>(view);
+    m_Data = static_cast<char *>(view) + c_RingLogHeaderSize;
+
+    const bool valid = std::memcmp(m_Header->magic, c_RingLogMagic, sizeof(c_RingLogMagic)) == 0 &&
+                       m_Header->version == c_RingLogVersion && m_Header->headerSize == c_RingLogHeaderSize &&
+                       m_Header->capacity == m_Capacity;
+
+    if (!valid)
+    {
+        std::memcpy(m_Header->magic, c_RingLogMagic, sizeof(c_RingLogMagic));
+        m_Header->version = c_RingLogVersion;
+        m_Header->headerSize = static_cast<uint32_t>(c_RingLogHeaderSize);
+        m_Header->capacity = m_Capacity;
+        std::atomic_ref<uint64_t>(m_Header->writePos).store(0, std::memory_order_relaxed);
+    }
+}
+
+ae::RingFileWriter::~RingFileWriter()
+{
+    Close();
+}
+
+void ae::RingFileWriter::Write(std::string_view text)
+{
+    if (text.size() > m_Capacity)
+    {
+        text.remove_prefix(text.size() - m_Capacity);
+    }
+
+    const uint64_t start =
+        std::atomic_ref<uint64_t>(m_Header->writePos).fetch_add(text.size(), std::memory_order_relaxed);
+    const size_t offset = static_cast<size_t>(start % m_Capacity);
+    const size_t head = std::min(text.size(), m_Capacity - offset);
+
+    std::memcpy(m_Data + offset, text.data(), head);
+    std::memcpy(m_Data, text.data() + head, text.size() - head);
+}
+
+void ae::RingFileWriter::Flush()
+{
+#ifdef AE_WINDOWS
+    FlushViewOfFile(m_Header, m_MappedSize);
+#else
+    ::msync(m_Header, m_MappedSize, MS_ASYNC);
+#endif // AE_WINDOWS
+}
+
+void ae::RingFileWriter::Close()
+{
+#ifdef AE_WINDOWS
+    if (m_Header != nullptr)
+    {
+        UnmapViewOfFile(m_Header);
+    }
+
+    if (m_Mapping != nullptr)
+    {
+        CloseHandle(m_Mapping);
+    }
+
+    if (m_File != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_File);
+    }
+
+    m_Mapping = nullptr;
+    m_File = INVALID_HANDLE_VALUE;
+#else
+    if (m_Header != nullptr)
+    {
+        ::munmap(m_Header, m_MappedSize);
+    }
+
+    if (m_File >= 0)
+    {
+        ::close(m_File);
+    }
+
+    m_File = -1;
+#endif // AE_WINDOWS
+
+    m_Header = nullptr;
+    m_Data = nullptr;
+}
+
+std::string ae::ReadRingLogFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        AE_THROW_FILE_NOT_FOUND_ERROR("Failed to open ring log file at '{}'", path);
+    }
+
+    RingLogFileHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    if (!file || std::memcmp(header.magic, c_RingLogMagic, sizeof(c_RingLogMagic)) != 0 ||
+        header.version != c_RingLogVersion || header.headerSize != c_RingLogHeaderSize || header.capacity == 0)
+    {
+        AE_THROW_RUNTIME_ERROR("File at '{}' is not a ring log file", path);
+    }
+
+    std::string ring(static_cast<size_t>(header.capacity), '\0');
+    file.seekg(static_cast<std::streamoff>(c_RingLogHeaderSize));
+    file.read(ring.data(), static_cast<std::streamsize>(ring.size()));
+
+    if (!file)
+    {
+        AE_THROW_RUNTIME_ERROR("Ring log file at '{}' is shorter than its header claims", path);
+    }
+
+    if (header.writePos <= header.capacity)
+    {
+        ring.resize(static_cast<size_t>(header.writePos));
+    }
+
+    else
+    {
+        // Unroll so the oldest byte comes first, then drop the line that was partly overwritten
+        std::rotate(ring.begin(), ring.begin() + static_cast<std::ptrdiff_t>(header.writePos % header.capacity),
+                    ring.end());
+        const size_t firstLine = ring.find('\n');
+        ring.erase(0, firstLine == std::string::npos ? ring.size() : firstLine + 1);
+    }
+
+    // Bytes reserved by a writer that never finished copying are still zero
+    std::erase(ring, '\0');
+    return ring;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Log.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ae
+{
+constexpr char c_RingLogMagic[8] = { 'A', 'E', 'L', 'O', 'G', 'R', 'N', 'G' };
+constexpr uint32_t c_RingLogVersion = 1;
+constexpr size_t c_RingLogHeaderSize = 64;
+
+// Start of a ring log file, followed by capacity bytes of wrapping text
+struct RingLogFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t capacity;
+    // Total number of bytes ever written, the next byte goes to writePos % capacity. Only accessed through
+    // std::atomic_ref while mapped.
+    alignas(std::atomic_ref<uint64_t>::required_alignment) uint64_t writePos;
+};
+
+static_assert(sizeof(RingLogFileHeader) <= c_RingLogHeaderSize);
+
+// Owns the mapping behind a ring file sink. Writers reserve their bytes with one atomic add and copy the text
+// straight into the mapping, nothing is handed to the OS until it writes back the dirty pages on its own. A file
+// written by an earlier run with the same capacity is continued rather than cleared, so the lines leading up to a
+// crash survive a restart.
+class RingFileWriter
+{
+  public:
+    // Throws FileOpenError if the file cannot be created or mapped
+    RingFileWriter(const std::string &path, size_t capacity);
+    ~RingFileWriter();
+
+    RingFileWriter(const RingFileWriter &) = delete;
+    RingFileWriter(RingFileWriter &&) = delete;
+    RingFileWriter &operator=(const RingFileWriter &) = delete;
+    RingFileWriter &operator=(RingFileWriter &&) = delete;
+
+    // Text longer than the ring only keeps its tail. A writer lapped by a full ring of newer text while copying can
+    // leave a garbled line behind.
+    void Write(std::string_view text);
+    // Asks the OS to start writing back dirty pages, only needed to survive a machine crash
+    void Flush();
+
+  private:
+    // Also used to clean up after a failed constructor
+    void Close();
+
+  private:
+    RingLogFileHeader *m_Header;
+    char *m_Data;
+    size_t m_Capacity;
+    size_t m_MappedSize;
+#ifdef AE_WINDOWS
+    HANDLE m_File;
+    HANDLE m_Mapping;
+#else
+    int m_File;
+#endif // AE_WINDOWS
+};
+} // namespace ae
@@ -0,0 +1,312 @@
+#include "general/pch.h"
+
+#include "sinks/RotatingFileWriter.h"
+
+#include "crash/CrashHandler.h"
+
+#include <algorithm>
+#include <charconv>
+#include <utility>
+#include <vector>
+
+#ifdef AE_WINDOWS
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#endif // AE_WINDOWS
+
+ae::RotatingFileWriter::RotatingFileWriter(const std::filesystem::path &path, const LogFileRotationOptions &options)
+    : m_Directory(path.parent_path()), m_Stem(path.stem().string()), m_Extension(path.extension().string()),
+      m_Options(options), m_Current(nullptr), m_CurrentBytes(0), m_CurrentDeadline(), m_Next(nullptr),
+      m_NextSequence(0), m_Retired(nullptr), m_WantNext(true), m_Stop(false), m_Sequence(1)
+{
+    FindExistingSegments();
+
+    const std::filesystem::path first = SegmentPath(m_Sequence, std::chrono::system_clock::now());
+    m_Current = OpenSegment(first);
+
+    if (m_Current == nullptr)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open log file segment at '{}'", first.string());
+    }
+
+    m_CurrentDeadline = std::chrono::steady_clock::now() + m_Options.interval;
+    m_Segments.push_back(first);
+    ++m_Sequence;
+
+    PruneSegments();
+
+    m_Helper = std::thread(&RotatingFileWriter::RunHelper, this);
+}
+
+ae::RotatingFileWriter::~RotatingFileWriter()
+{
+    {
+        std::scoped_lock lock(m_Mutex);
+        m_Stop = true;
+    }
+
+    m_Wake.notify_one();
+    m_Helper.join();
+
+    // Whatever the helper did not get to before stopping
+    if (m_Retired != nullptr)
+    {
+        std::fclose(m_Retired);
+    }
+
+    if (m_Activated)
+    {
+        FinishActivation(*m_Activated);
+    }
+
+    std::fclose(m_Current);
+
+    if (m_Next != nullptr)
+    {
+        std::fclose(m_Next);
+
+        std::error_code ec;
+        std::filesystem::remove(PendingPath(m_NextSequence), ec);
+    }
+}
+
+void ae::RotatingFileWriter::Write(std::string_view text)
+{
+    std::scoped_lock lock(m_Mutex);
+
+    const bool sizeReached = m_Options.maxBytes != 0 && m_CurrentBytes != 0 &&
+                             m_CurrentBytes + text.size() > m_Options.maxBytes;
+    const bool intervalReached =
+        m_Options.interval.count() != 0 && std::chrono::steady_clock::now() >= m_CurrentDeadline;
+
+    if (sizeReached || intervalReached)
+    {
+        Rotate();
+    }
+
+    std::fwrite(text.data(), 1, text.size(), m_Current);
+    m_CurrentBytes += text.size();
+}
+
+void ae::RotatingFileWriter::Flush()
+{
+    std::scoped_lock lock(m_Mutex);
+    std::fflush(m_Current);
+}
+
+void ae::RotatingFileWriter::WriteCrashMarker(std::string_view marker)
+{
+    FILE *current = m_Current;
+
+    WriteStreamBufferOnCrash(current);
+#ifdef AE_WINDOWS
+    WriteOnCrash(_fileno(current), marker);
+#else
+    WriteOnCrash(fileno(current), marker);
+#endif // AE_WINDOWS
+}
+
+std::filesystem::path ae::RotatingFileWriter::SegmentPath(uint64_t sequence,
+                                                          std::chrono::system_clock::time_point start) const
+{
+    return m_Directory / std::format("{}.{:06}.{:%Y%m%d-%H%M%S}{}", m_Stem, sequence,
+                                     std::chrono::floor<std::chrono::seconds>(start), m_Extension);
+}
+
+std::filesystem::path ae::RotatingFileWriter::PendingPath(uint64_t sequence) const
+{
+    return m_Directory / std::format("{}.{:06}.pending{}", m_Stem, sequence, m_Extension);
+}
+
+FILE *ae::RotatingFileWriter::OpenSegment(const std::filesystem::path &path) const
+{
+    // Space for a full segment is reserved without changing the file size, so the file system does not have to
+    // extend the file piece by piece while the logging path writes
+#ifdef AE_WINDOWS
+    // Opened with FILE_SHARE_DELETE so the helper can rename the segment while it is being written
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    if (m_Options.maxBytes != 0)
+    {
+        FILE_ALLOCATION_INFO allocation{};
+        allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(m_Options.maxBytes);
+        SetFileInformationByHandle(handle, FileAllocationInfo, &allocation, sizeof(allocation));
+    }
+
+    const int descriptor = _open_osfhandle(reinterpret_cast<intptr_t>(handle), _O_WRONLY | _O_TEXT);
+
+    if (descriptor < 0)
+    {
+        CloseHandle(handle);
+        return nullptr;
+    }
+
+    FILE *stream = _fdopen(descriptor, "w");
+
+    if (stream == nullptr)
+    {
+        _close(descriptor);
+    }
+
+    return stream;
+#else
+    FILE *stream = std::fopen(path.c_str(), "w");
+
+#ifdef AE_LINUX
+    if (stream != nullptr && m_Options.maxBytes != 0)
+    {
+        // Best effort, not every file system supports it
+        ::fallocate(fileno(stream), FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(m_Options.maxBytes));
+    }
+#endif // AE_LINUX
+
+    return stream;
+#endif // AE_WINDOWS
+}
+
+void ae::RotatingFileWriter::FindExistingSegments()
+{
+    // Segments from earlier runs count towards retention and the sequence continues after them
+    std::vector<std::pair<uint64_t, std::filesystem::path>> found;
+    std::error_code ec;
+
+    for (const auto &entry : std::filesystem::directory_iterator(m_Directory.empty() ? "." : m_Directory, ec))
+    {
+        const std::string name = entry.path().filename().string();
+        const size_t prefix = m_Stem.size() + 1;
+
+        if (name.size() <= prefix + m_Extension.size() || !name.starts_with(m_Stem + ".") ||
+            !name.ends_with(m_Extension))
+        {
+            continue;
+        }
+
+        // <sequence>.<YYYYMMDD-HHMMSS>
+        const std::string_view middle =
+            std::string_view(name).substr(prefix, name.size() - prefix - m_Extension.size());
+        const size_t dot = middle.find('.');
+
+        if (dot == std::string_view::npos || middle.size() - dot - 1 != 15 || middle[dot + 9] != '-')
+        {
+            continue;
+        }
+
+        uint64_t sequence = 0;
+        const auto [end, error] = std::from_chars(middle.data(), middle.data() + dot, sequence);
+
+        if (error == std::errc() && end == middle.data() + dot)
+        {
+            found.emplace_back(sequence, m_Directory / name);
+        }
+    }
+
+    std::ranges::sort(found);
+
+    for (auto &[sequence, segment] : found)
+    {
+        m_Segments.push_back(std::move(segment));
+        m_Sequence = sequence + 1;
+    }
+}
+
+void ae::RotatingFileWriter::Rotate()
+{
+    // Keep writing to the current segment if the helper has not prepared the next one yet
+    if (m_Next == nullptr)
+    {
+        m_WantNext = true;
+        m_Wake.notify_one();
+        return;
+    }
+
+    m_Retired = std::exchange(m_Current, std::exchange(m_Next, nullptr));
+    m_Activated = Activation{ .pendingPath = PendingPath(m_NextSequence),
+                              .sequence = m_NextSequence,
+                              .start = std::chrono::system_clock::now() };
+    m_CurrentBytes = 0;
+    m_CurrentDeadline = std::chrono::steady_clock::now() + m_Options.interval;
+    m_WantNext = true;
+
+    m_Wake.notify_one();
+}
+
+void ae::RotatingFileWriter::RunHelper()
+{
+    std::unique_lock lock(m_Mutex);
+
+    while (true)
+    {
+        m_Wake.wait(lock, [this] { return m_Stop || m_Retired != nullptr || m_Activated || m_WantNext; });
+
+        if (m_Stop)
+        {
+            break;
+        }
+
+        FILE *retired = std::exchange(m_Retired, nullptr);
+        const std::optional<Activation> activated = std::exchange(m_Activated, std::nullopt);
+        const bool wantNext = std::exchange(m_WantNext, false) && m_Next == nullptr;
+
+        lock.unlock();
+
+        if (retired != nullptr)
+        {
+            std::fclose(retired);
+        }
+
+        if (activated)
+        {
+            FinishActivation(*activated);
+        }
+
+        // Retried the next time the logging path asks for a rotation if this fails
+        FILE *next = wantNext ? OpenSegment(PendingPath(m_Sequence)) : nullptr;
+
+        lock.lock();
+
+        if (next != nullptr)
+        {
+            m_Next = next;
+            m_NextSequence = m_Sequence++;
+        }
+    }
+}
+
+void ae::RotatingFileWriter::FinishActivation(const Activation &activation)
+{
+    const std::filesystem::path segment = SegmentPath(activation.sequence, activation.start);
+
+    std::error_code ec;
+    std::filesystem::rename(activation.pendingPath, segment, ec);
+
+    if (ec)
+    {
+        std::fputs("Failed to rename log file segment, it keeps its pending name\n", stderr);
+        m_Segments.push_back(activation.pendingPath);
+    }
+
+    else
+    {
+        m_Segments.push_back(segment);
+    }
+
+    PruneSegments();
+}
+
+void ae::RotatingFileWriter::PruneSegments()
+{
+    while (m_Options.maxFiles != 0 && m_Segments.size() > m_Options.maxFiles)
+    {
+        std::error_code ec;
+        std::filesystem::remove(m_Segments.front(), ec);
+        m_Segments.pop_front();
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace ae
+{
+// Owns the segments behind a rotating file sink. A helper thread opens and reserves space for the next segment ahead
+// of time, so rotating on the logging path only swaps two stream pointers. The helper also closes the retired
+// segment, renames the new one after the time it was started and deletes segments past the retention count.
+class RotatingFileWriter
+{
+  public:
+    // Throws FileOpenError if the first segment cannot be created
+    RotatingFileWriter(const std::filesystem::path &path, const LogFileRotationOptions &options);
+    ~RotatingFileWriter();
+
+    RotatingFileWriter(const RotatingFileWriter &) = delete;
+    RotatingFileWriter(RotatingFileWriter &&) = delete;
+    RotatingFileWriter &operator=(const RotatingFileWriter &) = delete;
+    RotatingFileWriter &operator=(RotatingFileWriter &&) = delete;
+
+    void Write(std::string_view text);
+    void Flush();
+    // Writes the current segment's stdio buffer and marker without the lock, only for the crash handler
+    void WriteCrashMarker(std::string_view marker);
+
+  private:
+    // A prepared segment that has been swapped in but still carries its pending name
+    struct Activation
+    {
+        std::filesystem::path pendingPath;
+        uint64_t sequence;
+        std::chrono::system_clock::time_point start;
+    };
+
+    [[nodiscard]] std::filesystem::path SegmentPath(uint64_t sequence,
+                                                    std::chrono::system_clock::time_point start) const;
+    [[nodiscard]] std::filesystem::path PendingPath(uint64_t sequence) const;
+    [[nodiscard]] FILE *OpenSegment(const std::filesystem::path &path) const;
+    void FindExistingSegments();
+    // Callers hold m_Mutex
+    void Rotate();
+    void RunHelper();
+    void FinishActivation(const Activation &activation);
+    void PruneSegments();
+
+  private:
+    std::filesystem::path m_Directory;
+    std::string m_Stem;
+    std::string m_Extension;
+    LogFileRotationOptions m_Options;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    FILE *m_Current;
+    size_t m_CurrentBytes;
+    std::chrono::steady_clock::time_point m_CurrentDeadline;
+    FILE *m_Next;
+    uint64_t m_NextSequence;
+    FILE *m_Retired;
+    std::optional<Activation> m_Activated;
+    bool m_WantNext;
+    bool m_Stop;
+
+    // Only touched by the helper thread once it runs
+    uint64_t m_Sequence;
+    std::deque<std::filesystem::path> m_Segments;
+
+    std::thread m_Helper;
+};
+} // namespace ae
@@ -0,0 +1,265 @@
+#include "general/pch.h"
+
+#include "sinks/SinkRegistry.h"
+
+#include "crash/CrashHandler.h"
+
+#include <thread>
+
+namespace
+{
+struct ReaderHandle
+{
+    const void *registry = nullptr;
+    void *record = nullptr;
+    uint32_t depth = 0;
+    std::atomic<bool> *inUse = nullptr;
+
+    ~ReaderHandle()
+    {
+        if (inUse != nullptr)
+        {
+            inUse->store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ReaderHandle t_ReaderHandle;
+} // namespace
+
+ae::LogSinkState::LogSinkState(std::string name, bool isFile, FILE *stream, bool ownsStream, LogSink sink)
+    : name(std::move(name)), isFile(isFile), stream(stream), ownsStream(ownsStream), descriptor(-1),
+      sink(std::move(sink))
+{
+    if (stream != nullptr)
+    {
+#ifdef AE_WINDOWS
+        descriptor = _fileno(stream);
+#else
+        descriptor = fileno(stream);
+#endif // AE_WINDOWS
+    }
+}
+
+ae::LogSinkState::~LogSinkState()
+{
+    if (ownsStream && stream != nullptr)
+    {
+        std::fclose(stream);
+    }
+}
+
+void ae::LogSinkState::WriteText(std::string_view text) const
+{
+    if (writeText)
+    {
+        writeText(text);
+    }
+
+    else if (stream != nullptr)
+    {
+        std::fwrite(text.data(), 1, text.size(), stream);
+    }
+}
+
+void ae::LogSinkState::Flush(bool force) const
+{
+    if (flush)
+    {
+        flush(force);
+    }
+
+    // stdio writes out on its own when its buffer fills, only forced flushes are passed on
+    else if (force && stream != nullptr)
+    {
+        std::fflush(stream);
+    }
+}
+
+void ae::LogSinkState::WriteCrashMarker(std::string_view marker) const
+{
+    if (writeCrashMarker)
+    {
+        writeCrashMarker(marker);
+    }
+
+    else if (stream != nullptr)
+    {
+        WriteStreamBufferOnCrash(stream);
+        WriteOnCrash(descriptor, marker);
+    }
+}
+
+const ae::LogSinkSlot *ae::LogSinkSnapshot::Find(const std::string &name) const
+{
+    for (const LogSinkSlot &slot : sinks)
+    {
+        if (slot.state->name == name)
+        {
+            return &slot;
+        }
+    }
+
+    return nullptr;
+}
+
+ae::SinkRegistry::ReadGuard::ReadGuard(const SinkRegistry &registry) : m_Record(&registry.AcquireRecord())
+{
+    // Nested reads (a sink that logs) stay inside the outermost section
+    if (t_ReaderHandle.depth++ == 0)
+    {
+        // The seq_cst store orders the announcement before the pointer load below, a writer that swaps the pointer
+        // afterwards is guaranteed to see this record as active
+        m_Record->epoch.store(registry.m_Epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    }
+
+    m_Snapshot = registry.m_Current.load(std::memory_order_seq_cst);
+}
+
+ae::SinkRegistry::ReadGuard::~ReadGuard()
+{
+    if (--t_ReaderHandle.depth == 0)
+    {
+        m_Record->epoch.store(0, std::memory_order_release);
+    }
+}
+
+ae::SinkRegistry::SinkRegistry(std::atomic<uint8_t> &enabledLevels, std::atomic<uint8_t> &textLevels,
+                               std::atomic<uint8_t> &binaryLevels)
+    : m_Current(new LogSinkSnapshot()), m_Epoch(1), m_Readers(nullptr), m_EnabledLevels(enabledLevels),
+      m_TextLevels(textLevels), m_BinaryLevels(binaryLevels)
+{
+}
+
+ae::SinkRegistry::~SinkRegistry()
+{
+    delete m_Current.load(std::memory_order_relaxed);
+
+    // Records still held by a running thread are left allocated, that thread releases its record when it exits
+    ReaderRecord *it = m_Readers.load(std::memory_order_acquire);
+
+    while (it != nullptr)
+    {
+        ReaderRecord *next = it->next;
+
+        if (!it->inUse.load(std::memory_order_acquire))
+        {
+            delete it;
+        }
+
+        it = next;
+    }
+}
+
+ae::SinkRegistry::ReaderRecord &ae::SinkRegistry::AcquireRecord() const
+{
+    if (t_ReaderHandle.registry == this)
+    {
+        return *static_cast<ReaderRecord *>(t_ReaderHandle.record);
+    }
+
+    ReaderRecord *record = nullptr;
+
+    // Reuse a record left behind by an exited thread before allocating a new one
+    for (ReaderRecord *it = m_Readers.load(std::memory_order_acquire); it != nullptr; it = it->next)
+    {
+        bool expected = false;
+
+        if (it->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+        {
+            record = it;
+            break;
+        }
+    }
+
+    if (record == nullptr)
+    {
+        record = new ReaderRecord();
+        record->inUse.store(true, std::memory_order_relaxed);
+        record->next = m_Readers.load(std::memory_order_relaxed);
+
+        while (!m_Readers.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                                std::memory_order_relaxed))
+        {
+        }
+    }
+
+    t_ReaderHandle.registry = this;
+    t_ReaderHandle.record = record;
+    t_ReaderHandle.inUse = &record->inUse;
+
+    return *record;
+}
+
+void ae::SinkRegistry::Retire(const LogSinkSnapshot *snapshot)
+{
+    WaitForReaders();
+    delete snapshot;
+}
+
+void ae::SinkRegistry::WaitForReaders() const
+{
+    ThrowIfReading();
+
+    // Readers that announce this epoch or later entered after the call
+    const uint64_t epoch = m_Epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+    for (ReaderRecord *it = m_Readers.load(std::memory_order_acquire); it != nullptr; it = it->next)
+    {
+        while (true)
+        {
+            const uint64_t seen = it->epoch.load(std::memory_order_seq_cst);
+
+            if (seen == 0 || seen >= epoch)
+            {
+                break;
+            }
+
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ae::SinkRegistry::ThrowIfReading()
+{
+    if (t_ReaderHandle.depth != 0)
+    {
+        AE_THROW_LOGIC_ERROR("Log sinks can not be added, removed or changed from inside a sink");
+    }
+}
+
+void ae::SinkRegistry::BuildDispatchTable(LogSinkSnapshot &snapshot)
+{
+    for (auto &sinks : snapshot.byLevel)
+    {
+        sinks.clear();
+    }
+
+    for (const LogSinkSlot &slot : snapshot.sinks)
+    {
+        for (auto level = static_cast<size_t>(slot.minLevel); level <= static_cast<size_t>(slot.maxLevel); ++level)
+        {
+            snapshot.byLevel[level].push_back(slot.state.get());
+        }
+    }
+}
+
+uint8_t ae::SinkRegistry::ComputeLevels(const LogSinkSnapshot &snapshot, bool wantsArguments)
+{
+    uint8_t levels = 0;
+
+    for (const LogSinkSlot &slot : snapshot.sinks)
+    {
+        if (slot.state->wantsArguments != wantsArguments)
+        {
+            continue;
+        }
+
+        for (auto level = static_cast<uint32_t>(slot.minLevel); level <= static_cast<uint32_t>(slot.maxLevel); ++level)
+        {
+            levels |= static_cast<uint8_t>(1u << level);
+        }
+    }
+
+    return levels;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "Log.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ae
+{
+// Hooks for sinks that do their own buffering instead of writing through a stdio stream
+typedef std::move_only_function<void(std::string_view text) const> LogSinkTextWriter;
+typedef std::move_only_function<void(bool force) const> LogSinkFlusher;
+// Called by the crash handler, see LogSinkState::WriteCrashMarker
+typedef std::move_only_function<void(std::string_view marker) const> LogSinkCrashWriter;
+
+// A registered sink. Shared between every snapshot that contains it and destroyed, closing its file if it owns one,
+// once the last of those snapshots is retired.
+struct LogSinkState
+{
+    LogSinkState(std::string name, bool isFile, FILE *stream, bool ownsStream, LogSink sink);
+    ~LogSinkState();
+
+    LogSinkState(const LogSinkState &) = delete;
+    LogSinkState(LogSinkState &&) = delete;
+    LogSinkState &operator=(const LogSinkState &) = delete;
+    LogSinkState &operator=(LogSinkState &&) = delete;
+
+    // Raw text outside of messages, such as the open and termination messages and newlines
+    void WriteText(std::string_view text) const;
+    // Unforced flushes only give buffering sinks a chance to write out lines that have waited too long
+    void Flush(bool force) const;
+    // Writes out what the sink still buffers followed by marker, using write(2) and without taking any locks. Only
+    // called from the crash handler while the process is dying.
+    void WriteCrashMarker(std::string_view marker) const;
+
+    std::string name;
+    bool isFile;
+    FILE *stream;    // Null for sinks that set writeText and flush
+    bool ownsStream; // File sinks, console sinks borrow stdout / stderr
+    int descriptor;  // Of stream, looked up up front for the crash handler
+    bool wantsArguments = false; // Binary sinks, which store LogMessage::arguments rather than the text
+    bool wantsFields = false;    // Structured sinks, which write LogMessage::fields themselves
+    mutable std::atomic<int64_t> averageNanos{ 0 }; // Moving average of the time a write takes, see load shedding
+    mutable std::atomic<uint64_t> messages{ 0 };
+    mutable std::atomic<uint64_t> bytes{ 0 }; // Counted by the sink itself, see CountSinkBytes in Logger.cpp
+    mutable LatencyHistogram latency;         // Only recorded while sink latency stats are enabled
+    mutable std::atomic<bool> failed{ false }; // Set once the sink has thrown, see ReportSinkFailure in Logger.cpp
+    LogSink sink;
+    LogSinkTextWriter writeText;
+    LogSinkFlusher flush;
+    LogSinkCrashWriter writeCrashMarker;
+};
+
+struct LogSinkSlot
+{
+    std::shared_ptr<LogSinkState> state;
+    LogLevel minLevel;
+    LogLevel maxLevel;
+};
+
+// Immutable once published
+struct LogSinkSnapshot
+{
+    std::vector<LogSinkSlot> sinks; // In registration order, for lookups by name
+    // For each level the sinks accepting it, in registration order. Writing a message only walks its own level.
+    std::array<std::vector<const LogSinkState *>, c_LogLevelCount> byLevel;
+    uint8_t enabledLevels = 0;
+    uint8_t textLevels = 0;
+    uint8_t binaryLevels = 0;
+
+    [[nodiscard]] const LogSinkSlot *Find(const std::string &name) const;
+};
+
+// Publishes the sink set as an immutable snapshot behind one atomic pointer. Readers announce the epoch they entered
+// in a per-thread record and never wait. Writers copy the current snapshot, publish the modified copy and wait for
+// every reader that entered before the swap to leave before destroying the old one.
+class SinkRegistry
+{
+  private:
+    struct alignas(64) ReaderRecord
+    {
+        std::atomic<uint64_t> epoch{ 0 }; // 0 while the owning thread is outside a read section
+        std::atomic<bool> inUse{ false };
+        ReaderRecord *next = nullptr;
+    };
+
+  public:
+    class ReadGuard
+    {
+      public:
+        explicit ReadGuard(const SinkRegistry &registry);
+        ~ReadGuard();
+
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard(ReadGuard &&) = delete;
+        ReadGuard &operator=(const ReadGuard &) = delete;
+        ReadGuard &operator=(ReadGuard &&) = delete;
+
+        inline const LogSinkSnapshot *operator->() const
+        {
+            return m_Snapshot;
+        }
+
+        inline const LogSinkSnapshot &operator*() const
+        {
+            return *m_Snapshot;
+        }
+
+      private:
+        ReaderRecord *m_Record;
+        const LogSinkSnapshot *m_Snapshot;
+    };
+
+    // enabledLevels receives the union of the levels accepted by the published sinks, textLevels and binaryLevels
+    // the levels accepted by sinks that do and do not want LogMessage::arguments
+    SinkRegistry(std::atomic<uint8_t> &enabledLevels, std::atomic<uint8_t> &textLevels,
+                 std::atomic<uint8_t> &binaryLevels);
+    ~SinkRegistry();
+
+    SinkRegistry(const SinkRegistry &) = delete;
+    SinkRegistry(SinkRegistry &&) = delete;
+    SinkRegistry &operator=(const SinkRegistry &) = delete;
+    SinkRegistry &operator=(SinkRegistry &&) = delete;
+
+    [[nodiscard]] inline ReadGuard Read() const
+    {
+        return ReadGuard(*this);
+    }
+
+    // The current snapshot without entering a read section, which can allocate. Only for the crash handler, a
+    // concurrent update could retire the snapshot while it is used.
+    [[nodiscard]] inline const LogSinkSnapshot *ReadUnguarded() const
+    {
+        return m_Current.load(std::memory_order_acquire);
+    }
+
+    // Applies modify to a copy of the current snapshot and publishes it, returns false without publishing if modify
+    // does. Throws a LogicError when called from inside a read section on the same thread, such as from a sink, as
+    // retiring the old snapshot would wait for that section forever.
+    template <class Modify> bool Update(Modify &&modify)
+    {
+        ThrowIfReading();
+
+        std::scoped_lock lock(m_WriteMutex);
+
+        auto next = std::make_unique<LogSinkSnapshot>(*m_Current.load(std::memory_order_relaxed));
+
+        if (!modify(*next))
+        {
+            return false;
+        }
+
+        BuildDispatchTable(*next);
+
+        const uint8_t textLevels = ComputeLevels(*next, false);
+        const uint8_t binaryLevels = ComputeLevels(*next, true);
+        const uint8_t enabledLevels = textLevels | binaryLevels;
+
+        next->textLevels = textLevels;
+        next->binaryLevels = binaryLevels;
+        next->enabledLevels = enabledLevels;
+
+        Retire(m_Current.exchange(next.release(), std::memory_order_seq_cst));
+
+        // Publish the levels before the generation so a call site that sees the new generation also sees the new
+        // levels. Both happen under the write lock so they can not be reordered between two writers.
+        m_TextLevels.store(textLevels, std::memory_order_relaxed);
+        m_BinaryLevels.store(binaryLevels, std::memory_order_relaxed);
+        m_EnabledLevels.store(enabledLevels, std::memory_order_release);
+        g_LogGeneration.fetch_add(1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Returns once every read section entered before the call has ended. Throws a LogicError when called from inside
+    // a read section on the same thread.
+    void WaitForReaders() const;
+
+  private:
+    ReaderRecord &AcquireRecord() const;
+    static void ThrowIfReading();
+    void Retire(const LogSinkSnapshot *snapshot);
+
+    static void BuildDispatchTable(LogSinkSnapshot &snapshot);
+    static uint8_t ComputeLevels(const LogSinkSnapshot &snapshot, bool wantsArguments);
+
+  private:
+    std::atomic<const LogSinkSnapshot *> m_Current;
+    mutable std::atomic<uint64_t> m_Epoch;
+    mutable std::atomic<ReaderRecord *> m_Readers;
+    std::mutex m_WriteMutex;
+    std::atomic<uint8_t> &m_EnabledLevels;
+    std::atomic<uint8_t> &m_TextLevels;
+    std::atomic<uint8_t> &m_BinaryLevels;
+};
+} // namespace ae
@@ -0,0 +1,323 @@
+#include "general/pch.h"
+
+#include "sinks/StructuredLines.h"
+
+#include "binary/BinaryArgs.h"
+#include "sinks/LogLines.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+constexpr uint64_t c_ByteOnes = 0x0101010101010101ull;
+constexpr uint64_t c_ByteHighs = 0x8080808080808080ull;
+
+// Non-zero if any byte of the word is below limit, which must not exceed 0x80
+constexpr uint64_t BytesBelow(uint64_t word, uint8_t limit)
+{
+    return (word - c_ByteOnes * limit) & ~word & c_ByteHighs;
+}
+
+constexpr uint64_t BytesEqual(uint64_t word, uint8_t value)
+{
+    return BytesBelow(word ^ (c_ByteOnes * value), 1);
+}
+
+// Escaped in JSON strings and quoted logfmt values
+constexpr bool NeedsEscape(char c)
+{
+    return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+}
+
+// logfmt values containing any of these are quoted
+constexpr bool NeedsQuotes(char c)
+{
+    return static_cast<unsigned char>(c) <= 0x20 || c == '"' || c == '\\' || c == '=';
+}
+
+// Tests eight characters at a time and only looks at single characters once a word contains a match, most text has
+// nothing to escape at all
+template <bool Quotes> size_t FindSpecial(std::string_view text, size_t pos)
+{
+    for (; pos + sizeof(uint64_t) <= text.size(); pos += sizeof(uint64_t))
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, text.data() + pos, sizeof(word));
+
+        uint64_t special = BytesBelow(word, Quotes ? 0x21 : 0x20) | BytesEqual(word, '"') | BytesEqual(word, '\\');
+
+        if constexpr (Quotes)
+        {
+            special |= BytesEqual(word, '=');
+        }
+
+        if (special != 0)
+        {
+            break;
+        }
+    }
+
+    for (; pos < text.size(); ++pos)
+    {
+        if (Quotes ? NeedsQuotes(text[pos]) : NeedsEscape(text[pos]))
+        {
+            return pos;
+        }
+    }
+
+    return text.size();
+}
+
+void AppendEscaped(std::string &out, std::string_view text)
+{
+    size_t start = 0;
+
+    while (true)
+    {
+        const size_t pos = FindSpecial<false>(text, start);
+        out.append(text.data() + start, pos - start);
+
+        if (pos == text.size())
+        {
+            return;
+        }
+
+        switch (text[pos])
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            std::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned char>(text[pos]));
+        }
+
+        start = pos + 1;
+    }
+}
+
+void AppendString(std::string &out, std::string_view text, ae::LogStructuredKind kind)
+{
+    if (kind == ae::LogStructuredKind::LOGFMT && !text.empty() && FindSpecial<true>(text, 0) == text.size())
+    {
+        out.append(text);
+        return;
+    }
+
+    out.push_back('"');
+    AppendEscaped(out, text);
+    out.push_back('"');
+}
+
+template <class T> void AppendNumber(std::string &out, T value)
+{
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void AppendKey(std::string &out, std::string_view key, ae::LogStructuredKind kind)
+{
+    if (kind == ae::LogStructuredKind::JSON)
+    {
+        AppendString(out, key, kind);
+        return;
+    }
+
+    // logfmt keys can not be quoted
+    for (const char c : key)
+    {
+        out.push_back(NeedsQuotes(c) ? '_' : c);
+    }
+}
+
+void AppendValue(std::string &out, const ae::BinaryValue &value, ae::LogStructuredKind kind)
+{
+    std::visit(
+        [&out, kind](const auto &v)
+        {
+            using Value = std::remove_cvref_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<Value, bool>)
+            {
+                out += v ? "true" : "false";
+            }
+
+            else if constexpr (std::is_same_v<Value, char>)
+            {
+                AppendString(out, std::string_view(&v, 1), kind);
+            }
+
+            else if constexpr (std::is_same_v<Value, std::string_view>)
+            {
+                AppendString(out, v, kind);
+            }
+
+            else if constexpr (std::is_same_v<Value, const void *>)
+            {
+                if (kind == ae::LogStructuredKind::JSON)
+                {
+                    std::format_to(std::back_inserter(out), "\"{}\"", v);
+                }
+
+                else
+                {
+                    std::format_to(std::back_inserter(out), "{}", v);
+                }
+            }
+
+            else if constexpr (std::is_floating_point_v<Value>)
+            {
+                // JSON has no infinity or NaN
+                if (kind == ae::LogStructuredKind::JSON && !std::isfinite(v))
+                {
+                    out += "null";
+                }
+
+                else
+                {
+                    AppendNumber(out, v);
+                }
+            }
+
+            else
+            {
+                AppendNumber(out, v);
+            }
+        },
+        value);
+}
+
+template <class Append> void ForEachField(const ae::LogMessage &message, Append &&append)
+{
+    thread_local std::vector<ae::BinaryValue> values;
+    ae::DecodeBinaryArgs(ae::AsChars(message.fields), values);
+
+    // EncodeLogFields only writes string keys
+    for (size_t i = 0; i + 1 < values.size(); i += 2)
+    {
+        append(std::get<std::string_view>(values[i]), values[i + 1]);
+    }
+}
+
+std::string_view MessageText(const ae::LogMessage &message)
+{
+    return message.fields.empty() ? std::string_view(message.message) : message.site->format;
+}
+
+// ISO 8601 in UTC with milliseconds
+void AppendTimestamp(std::string &out, std::chrono::system_clock::time_point time)
+{
+    // The date only changes once a second and is by far the slowest part to format
+    thread_local std::chrono::sys_seconds cachedSecond{};
+    thread_local std::string cachedDate;
+
+    const auto second = std::chrono::floor<std::chrono::seconds>(time);
+
+    if (second != cachedSecond || cachedDate.empty())
+    {
+        cachedDate.clear();
+        std::format_to(std::back_inserter(cachedDate), "{:%FT%T}", second);
+        cachedSecond = second;
+    }
+
+    out += cachedDate;
+    std::format_to(std::back_inserter(out), ".{:03}Z",
+                   std::chrono::duration_cast<std::chrono::milliseconds>(time - second).count());
+}
+} // namespace
+
+void ae::AppendJsonLine(std::string &out, const LogMessage &message)
+{
+    constexpr LogStructuredKind kind = LogStructuredKind::JSON;
+
+    out += "{\"time\":\"";
+    AppendTimestamp(out, Clock::ToSystemTime(message.time));
+    out += "\",\"level\":\"";
+    out += c_LevelLookup[static_cast<uint32_t>(message.level)];
+    out += "\",\"file\":";
+    AppendString(out, message.site->file, kind);
+    out += ",\"line\":";
+    AppendNumber(out, message.site->line);
+    out += ",\"message\":";
+    AppendString(out, MessageText(message), kind);
+
+    if (!message.fields.empty())
+    {
+        ForEachField(message,
+                     [&out](std::string_view key, const BinaryValue &value)
+                     {
+                         out.push_back(',');
+                         AppendKey(out, key, kind);
+                         out.push_back(':');
+                         AppendValue(out, value, kind);
+                     });
+    }
+
+    out += "}\n";
+}
+
+void ae::AppendLogfmtLine(std::string &out, const LogMessage &message)
+{
+    constexpr LogStructuredKind kind = LogStructuredKind::LOGFMT;
+
+    out += "time=";
+    AppendTimestamp(out, Clock::ToSystemTime(message.time));
+    out += " level=";
+    out += c_LevelLookup[static_cast<uint32_t>(message.level)];
+    out += " file=";
+    AppendString(out, message.site->file, kind);
+    out += " line=";
+    AppendNumber(out, message.site->line);
+    out += " message=";
+    AppendString(out, MessageText(message), kind);
+
+    if (!message.fields.empty())
+    {
+        ForEachField(message,
+                     [&out](std::string_view key, const BinaryValue &value)
+                     {
+                         out.push_back(' ');
+                         AppendKey(out, key, kind);
+                         out.push_back('=');
+                         AppendValue(out, value, kind);
+                     });
+    }
+
+    out.push_back('\n');
+}
+
+void ae::AppendFieldText(std::string &out, const LogMessage &message)
+{
+    constexpr LogStructuredKind kind = LogStructuredKind::LOGFMT;
+
+    out += message.site->format;
+
+    ForEachField(message,
+                 [&out](std::string_view key, const BinaryValue &value)
+                 {
+                     out.push_back(' ');
+                     AppendKey(out, key, kind);
+                     out.push_back('=');
+                     AppendValue(out, value, kind);
+                 });
+}
+
+void ae::AppendJsonEscaped(std::string &out, std::string_view text)
+{
+    AppendEscaped(out, text);
+}
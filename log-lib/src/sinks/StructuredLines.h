@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Log.h"
+
+#include <string>
+#include <string_view>
+
+namespace ae
+{
+// The line layouts of Logger::AddStructuredFileSink, each ends with a newline. Numbers and escaped strings are
+// written straight into out without a temporary string per field.
+void AppendJsonLine(std::string &out, const LogMessage &message);
+void AppendLogfmtLine(std::string &out, const LogMessage &message);
+
+// How sinks that do not understand fields show an AE_LOG_KV message, the message followed by logfmt pairs
+void AppendFieldText(std::string &out, const LogMessage &message);
+
+// Appends text escaped for use inside a JSON string, without the quotes
+void AppendJsonEscaped(std::string &out, std::string_view text);
+} // namespace ae
@@ -0,0 +1,383 @@
+#include "general/pch.h"
+
+#ifdef AE_LINUX
+
+#include "sinks/UringFileWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+namespace
+{
+int EnterRing(int ring, unsigned submit, unsigned minComplete, unsigned flags)
+{
+    long result = 0;
+
+    do
+    {
+        result = ::syscall(__NR_io_uring_enter, ring, submit, minComplete, flags, nullptr, 0);
+    } while (result < 0 && errno == EINTR);
+
+    return static_cast<int>(result);
+}
+} // namespace
+
+ae::UringFileWriter::UringFileWriter(const std::string &path, const LogUringFileOptions &options)
+    : m_File(-1), m_Offset(0), m_BufferSize(std::max<size_t>(options.bufferSize, 1)),
+      m_Buffers(std::max<uint32_t>(options.bufferCount, 1)), m_Current(0), m_InFlight(0), m_Fixed(false),
+      m_Failed(false), m_Ring(-1), m_SqRing(nullptr), m_SqRingSize(0), m_CqRing(nullptr), m_CqRingSize(0),
+      m_Sqes(nullptr), m_SqesSize(0), m_SqTail(nullptr), m_SqMask(nullptr), m_SqArray(nullptr), m_CqHead(nullptr),
+      m_CqTail(nullptr), m_CqMask(nullptr), m_Cqes(nullptr)
+{
+    m_File = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (m_File < 0)
+    {
+        AE_THROW_FILE_OPEN_ERROR("Failed to open io_uring log file at '{}'. Error: {}", path, std::strerror(errno));
+    }
+
+    for (Buffer &buffer : m_Buffers)
+    {
+        buffer.data = std::make_unique_for_overwrite<char[]>(m_BufferSize);
+    }
+
+    if (!SetUpRing(std::bit_ceil(static_cast<uint32_t>(m_Buffers.size()))))
+    {
+        TearDownRing();
+    }
+}
+
+ae::UringFileWriter::~UringFileWriter()
+{
+    Flush(true);
+
+    std::scoped_lock lock(m_Mutex);
+    TearDownRing();
+    ::close(m_File);
+}
+
+void ae::UringFileWriter::Write(std::string_view text)
+{
+    std::scoped_lock lock(m_Mutex);
+
+    Reap(false);
+
+    if (text.size() > m_BufferSize - m_Buffers[m_Current].used)
+    {
+        Submit(m_Current);
+        AcquireBuffer();
+
+        // Too large for any buffer, the offset is reserved so it still lands in order
+        if (text.size() > m_BufferSize)
+        {
+            const uint64_t offset = m_Offset;
+            m_Offset += text.size();
+            WriteAt(text.data(), text.size(), offset);
+            return;
+        }
+    }
+
+    Buffer &buffer = m_Buffers[m_Current];
+    std::memcpy(buffer.data.get() + buffer.used, text.data(), text.size());
+    buffer.used += text.size();
+}
+
+void ae::UringFileWriter::Flush(bool force)
+{
+    std::scoped_lock lock(m_Mutex);
+
+    if (m_Buffers[m_Current].used != 0)
+    {
+        Submit(m_Current);
+        AcquireBuffer();
+    }
+
+    while (force && m_InFlight != 0)
+    {
+        Reap(true);
+    }
+}
+
+void ae::UringFileWriter::WriteCrashMarker(std::string_view marker)
+{
+    Buffer &buffer = m_Buffers[m_Current];
+
+    WriteAt(buffer.data.get(), buffer.used, m_Offset);
+    WriteAt(marker.data(), marker.size(), m_Offset + buffer.used);
+
+    m_Offset += buffer.used + marker.size();
+    buffer.used = 0;
+}
+
+bool ae::UringFileWriter::SetUpRing(uint32_t entries)
+{
+    io_uring_params params{};
+    m_Ring = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+
+    if (m_Ring < 0)
+    {
+        return false;
+    }
+
+    m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+    if (singleMap)
+    {
+        m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+    }
+
+    void *sqRing = ::mmap(nullptr, m_SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Ring,
+                          IORING_OFF_SQ_RING);
+
+    if (sqRing == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_SqRing = sqRing;
+
+    void *cqRing = singleMap ? sqRing
+                             : ::mmap(nullptr, m_CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      m_Ring, IORING_OFF_CQ_RING);
+
+    if (cqRing == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_CqRing = cqRing;
+    m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    void *sqes =
+        ::mmap(nullptr, m_SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Ring, IORING_OFF_SQES);
+
+    if (sqes == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_Sqes = static_cast<io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(m_SqRing);
+    char *cq = static_cast<char *>(m_CqRing);
+
+    m_SqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_SqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_SqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    m_CqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_CqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_CqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_Cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // Registered buffers spare the kernel from mapping the pages on every write, plain writes work without them
+    std::vector<iovec> iovecs;
+
+    for (Buffer &buffer : m_Buffers)
+    {
+        iovecs.push_back(iovec{ buffer.data.get(), m_BufferSize });
+    }
+
+    m_Fixed = ::syscall(__NR_io_uring_register, m_Ring, IORING_REGISTER_BUFFERS, iovecs.data(),
+                        static_cast<unsigned>(iovecs.size())) == 0;
+
+    return true;
+}
+
+void ae::UringFileWriter::TearDownRing()
+{
+    if (m_Sqes != nullptr)
+    {
+        ::munmap(m_Sqes, m_SqesSize);
+    }
+
+    if (m_CqRing != nullptr && m_CqRing != m_SqRing)
+    {
+        ::munmap(m_CqRing, m_CqRingSize);
+    }
+
+    if (m_SqRing != nullptr)
+    {
+        ::munmap(m_SqRing, m_SqRingSize);
+    }
+
+    if (m_Ring >= 0)
+    {
+        ::close(m_Ring);
+    }
+
+    m_Ring = -1;
+    m_SqRing = nullptr;
+    m_CqRing = nullptr;
+    m_Sqes = nullptr;
+    m_Fixed = false;
+}
+
+void ae::UringFileWriter::Submit(uint32_t index)
+{
+    Buffer &buffer = m_Buffers[index];
+
+    if (buffer.used == 0)
+    {
+        return;
+    }
+
+    buffer.offset = m_Offset;
+    m_Offset += buffer.used;
+
+    if (m_Ring < 0)
+    {
+        WriteAt(buffer.data.get(), buffer.used, buffer.offset);
+        buffer.used = 0;
+        return;
+    }
+
+    // The kernel only reads the tail, this thread is the only one writing it
+    const unsigned tail = std::atomic_ref<unsigned>(*m_SqTail).load(std::memory_order_relaxed);
+    const unsigned slot = tail & *m_SqMask;
+
+    io_uring_sqe &sqe = m_Sqes[slot];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = m_Fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe.fd = m_File;
+    sqe.addr = reinterpret_cast<uint64_t>(buffer.data.get());
+    sqe.len = static_cast<uint32_t>(buffer.used);
+    sqe.off = buffer.offset;
+    sqe.buf_index = m_Fixed ? static_cast<uint16_t>(index) : 0;
+    sqe.user_data = index;
+
+    m_SqArray[slot] = slot;
+    std::atomic_ref<unsigned>(*m_SqTail).store(tail + 1, std::memory_order_release);
+
+    buffer.inFlight = true;
+    ++m_InFlight;
+
+    if (EnterRing(m_Ring, 1, 0, 0) >= 1)
+    {
+        return;
+    }
+
+    // The ring stopped accepting work, finish what it holds and continue with plain writes
+    std::atomic_ref<unsigned>(*m_SqTail).store(tail, std::memory_order_release);
+    buffer.inFlight = false;
+    --m_InFlight;
+
+    while (m_InFlight != 0)
+    {
+        Reap(true);
+    }
+
+    TearDownRing();
+
+    WriteAt(buffer.data.get(), buffer.used, buffer.offset);
+    buffer.used = 0;
+}
+
+void ae::UringFileWriter::Reap(bool wait)
+{
+    if (m_Ring < 0 || m_InFlight == 0)
+    {
+        return;
+    }
+
+    if (wait && EnterRing(m_Ring, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+    {
+        // Completions still arrive without the wait, the caller polls again
+        std::this_thread::yield();
+    }
+
+    unsigned head = std::atomic_ref<unsigned>(*m_CqHead).load(std::memory_order_relaxed);
+    const unsigned tail = std::atomic_ref<unsigned>(*m_CqTail).load(std::memory_order_acquire);
+
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe &cqe = m_Cqes[head & *m_CqMask];
+        Buffer &buffer = m_Buffers[cqe.user_data];
+
+        if (cqe.res < 0)
+        {
+            ReportFailure();
+        }
+
+        else if (static_cast<size_t>(cqe.res) < buffer.used)
+        {
+            const auto written = static_cast<size_t>(cqe.res);
+            WriteAt(buffer.data.get() + written, buffer.used - written, buffer.offset + written);
+        }
+
+        buffer.used = 0;
+        buffer.inFlight = false;
+        --m_InFlight;
+    }
+
+    std::atomic_ref<unsigned>(*m_CqHead).store(head, std::memory_order_release);
+}
+
+void ae::UringFileWriter::AcquireBuffer()
+{
+    const auto count = static_cast<uint32_t>(m_Buffers.size());
+
+    while (true)
+    {
+        for (uint32_t i = 1; i <= count; ++i)
+        {
+            const uint32_t index = (m_Current + i) % count;
+
+            if (!m_Buffers[index].inFlight && m_Buffers[index].used == 0)
+            {
+                m_Current = index;
+                return;
+            }
+        }
+
+        // Every buffer is being written, this is the only place a producer waits for the disk
+        Reap(true);
+    }
+}
+
+void ae::UringFileWriter::WriteAt(const char *data, size_t size, uint64_t offset)
+{
+    while (size != 0)
+    {
+        const ssize_t written = ::pwrite(m_File, data, size, static_cast<off_t>(offset));
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            ReportFailure();
+            return;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+void ae::UringFileWriter::ReportFailure()
+{
+    // A failing disk must not take the application down with it, report once and drop the data
+    if (!m_Failed)
+    {
+        m_Failed = true;
+        std::fputs("Failed to write io_uring log file, some lines were discarded\n", stderr);
+    }
+}
+
+#endif // AE_LINUX
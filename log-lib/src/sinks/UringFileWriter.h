@@ -0,0 +1,94 @@
+#pragma once
+
+#ifdef AE_LINUX
+
+#include "Log.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace ae
+{
+// Owns the file behind an io_uring file sink. Lines are copied into one of a few buffers registered with the kernel,
+// a full buffer is handed to the ring as a single write and the next free buffer takes over. Completions are reaped
+// without waiting on every write, producers only wait when every buffer is still in flight. If the ring can not be
+// set up, full buffers are written with pwrite on the calling thread instead.
+class UringFileWriter
+{
+  public:
+    // Throws FileOpenError if the file cannot be created
+    UringFileWriter(const std::string &path, const LogUringFileOptions &options);
+    ~UringFileWriter();
+
+    UringFileWriter(const UringFileWriter &) = delete;
+    UringFileWriter(UringFileWriter &&) = delete;
+    UringFileWriter &operator=(const UringFileWriter &) = delete;
+    UringFileWriter &operator=(UringFileWriter &&) = delete;
+
+    void Write(std::string_view text);
+    // Without force only submits the partly filled buffer, with force also waits for every write to complete
+    void Flush(bool force);
+    // Writes the current buffer and marker with pwrite and without the lock, only for the crash handler. Buffers
+    // already submitted are finished by the kernel.
+    void WriteCrashMarker(std::string_view marker);
+
+    [[nodiscard]] inline bool UsesRing() const
+    {
+        return m_Ring >= 0;
+    }
+
+  private:
+    struct Buffer
+    {
+        std::unique_ptr<char[]> data;
+        size_t used = 0;
+        bool inFlight = false;
+        uint64_t offset = 0; // Where in the file the write started, used to finish short writes
+    };
+
+    // Callers hold m_Mutex
+    [[nodiscard]] bool SetUpRing(uint32_t entries);
+    void TearDownRing();
+    void Submit(uint32_t index);
+    void Reap(bool wait);
+    void AcquireBuffer();
+    void WriteAt(const char *data, size_t size, uint64_t offset);
+    void ReportFailure();
+
+  private:
+    std::mutex m_Mutex;
+    int m_File;
+    uint64_t m_Offset;
+    size_t m_BufferSize;
+    std::vector<Buffer> m_Buffers;
+    uint32_t m_Current;
+    uint32_t m_InFlight;
+    bool m_Fixed; // Buffers are registered, writes use IORING_OP_WRITE_FIXED
+    bool m_Failed;
+
+    int m_Ring;
+    void *m_SqRing;
+    size_t m_SqRingSize;
+    void *m_CqRing;
+    size_t m_CqRingSize;
+    io_uring_sqe *m_Sqes;
+    size_t m_SqesSize;
+    unsigned *m_SqTail;
+    unsigned *m_SqMask;
+    unsigned *m_SqArray;
+    unsigned *m_CqHead;
+    unsigned *m_CqTail;
+    unsigned *m_CqMask;
+    io_uring_cqe *m_Cqes;
+};
+} // namespace ae
+
+#endif // AE_LINUX
@@ -0,0 +1,152 @@
+#include "general/pch.h"
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+uint64_t BucketLowest(size_t index)
+{
+    const size_t group = index >> ae::LatencyHistogram::c_SubBucketBits;
+    const uint64_t subBucket = index & (ae::LatencyHistogram::c_SubBucketCount - 1);
+
+    if (group == 0)
+    {
+        return subBucket;
+    }
+
+    return (ae::LatencyHistogram::c_SubBucketCount + subBucket) << (group - 1);
+}
+
+uint64_t BucketWidth(size_t index)
+{
+    const size_t group = index >> ae::LatencyHistogram::c_SubBucketBits;
+    return group == 0 ? 1 : uint64_t(1) << (group - 1);
+}
+
+std::chrono::nanoseconds ToNanoseconds(uint64_t nanos)
+{
+    return std::chrono::nanoseconds(static_cast<int64_t>(nanos));
+}
+} // namespace
+
+ae::LatencyHistogram::LatencyHistogram()
+    : m_Buckets(), m_Count(0), m_Sum(0), m_Min(std::numeric_limits<uint64_t>::max()), m_Max(0)
+{
+}
+
+void ae::LatencyHistogram::Add(const LatencyHistogram &other)
+{
+    for (size_t i = 0; i < c_BucketCount; ++i)
+    {
+        const uint64_t count = other.m_Buckets[i].load(std::memory_order_relaxed);
+
+        if (count != 0)
+        {
+            Increase(m_Buckets[i], count);
+        }
+    }
+
+    Increase(m_Count, other.m_Count.load(std::memory_order_relaxed));
+    Increase(m_Sum, other.m_Sum.load(std::memory_order_relaxed));
+    m_Min.store(std::min(m_Min.load(std::memory_order_relaxed), other.m_Min.load(std::memory_order_relaxed)),
+                std::memory_order_relaxed);
+    m_Max.store(std::max(m_Max.load(std::memory_order_relaxed), other.m_Max.load(std::memory_order_relaxed)),
+                std::memory_order_relaxed);
+}
+
+void ae::LatencyHistogram::Subtract(const LatencyHistogram &earlier)
+{
+    uint64_t min = std::numeric_limits<uint64_t>::max();
+    uint64_t max = 0;
+
+    for (size_t i = 0; i < c_BucketCount; ++i)
+    {
+        const uint64_t count =
+            m_Buckets[i].load(std::memory_order_relaxed) - earlier.m_Buckets[i].load(std::memory_order_relaxed);
+        m_Buckets[i].store(count, std::memory_order_relaxed);
+
+        if (count != 0)
+        {
+            min = std::min(min, BucketLowest(i));
+            max = BucketLowest(i) + BucketWidth(i) - 1;
+        }
+    }
+
+    m_Count.store(m_Count.load(std::memory_order_relaxed) - earlier.m_Count.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+    m_Sum.store(m_Sum.load(std::memory_order_relaxed) - earlier.m_Sum.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+
+    // The exact extremes are still right when they fall into the outermost buckets
+    m_Min.store(std::max(min, m_Min.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+    m_Max.store(std::min(max, m_Max.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+}
+
+void ae::LatencyHistogram::Clear()
+{
+    for (std::atomic<uint64_t> &bucket : m_Buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    m_Count.store(0, std::memory_order_relaxed);
+    m_Sum.store(0, std::memory_order_relaxed);
+    m_Min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    m_Max.store(0, std::memory_order_relaxed);
+}
+
+ae::LatencySummary ae::LatencyHistogram::Summarize() const
+{
+    // Totals are summed from the buckets, a histogram that is recording may be a sample ahead in m_Count
+    std::array<uint64_t, c_BucketCount> buckets{};
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < c_BucketCount; ++i)
+    {
+        buckets[i] = m_Buckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    LatencySummary summary{};
+
+    if (count == 0)
+    {
+        return summary;
+    }
+
+    const uint64_t min = m_Min.load(std::memory_order_relaxed);
+    const uint64_t max = std::max(m_Max.load(std::memory_order_relaxed), min);
+
+    summary.count = count;
+    summary.total = ToNanoseconds(m_Sum.load(std::memory_order_relaxed));
+    summary.mean = ToNanoseconds(m_Sum.load(std::memory_order_relaxed) / count);
+    summary.min = ToNanoseconds(min);
+    summary.max = ToNanoseconds(max);
+
+    const std::array<std::pair<double, std::chrono::nanoseconds *>, 4> percentiles = { {
+        { 0.5, &summary.p50 },
+        { 0.9, &summary.p90 },
+        { 0.99, &summary.p99 },
+        { 0.999, &summary.p999 },
+    } };
+
+    size_t bucket = 0;
+    uint64_t seen = buckets[0];
+
+    for (const auto &[fraction, result] : percentiles)
+    {
+        const uint64_t rank =
+            std::max<uint64_t>(static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(count))), 1);
+
+        while (seen < rank && bucket + 1 < c_BucketCount)
+        {
+            seen += buckets[++bucket];
+        }
+
+        // The middle of the bucket, kept within the recorded extremes
+        *result = ToNanoseconds(std::clamp(BucketLowest(bucket) + BucketWidth(bucket) / 2, min, max));
+    }
+
+    return summary;
+}
@@ -0,0 +1,124 @@
+#include "general/pch.h"
+
+#include "stats/StatsReporter.h"
+
+ae::StatsReporter::StatsReporter() : m_Stop(false) {}
+
+ae::StatsReporter::~StatsReporter()
+{
+    Stop();
+}
+
+void ae::StatsReporter::Schedule(StatsReportKind kind, std::chrono::milliseconds interval,
+                                 std::function<void()> report)
+{
+    {
+        std::scoped_lock lock(m_Mutex);
+
+        if (m_Stop)
+        {
+            return;
+        }
+
+        Report &slot = m_Reports[static_cast<size_t>(kind)];
+        slot.interval = interval;
+        slot.due = std::chrono::steady_clock::now() + interval;
+        slot.run = interval.count() > 0 ? std::make_shared<std::function<void()>>(std::move(report)) : nullptr;
+        slot.failed.store(false, std::memory_order_relaxed);
+
+        if (!m_Thread.joinable() && slot.run)
+        {
+            m_Thread = std::thread(&StatsReporter::Run, this);
+        }
+    }
+
+    m_Wake.notify_one();
+}
+
+void ae::StatsReporter::Stop()
+{
+    {
+        std::scoped_lock lock(m_Mutex);
+        m_Stop = true;
+    }
+
+    m_Wake.notify_one();
+
+    if (m_Thread.joinable())
+    {
+        m_Thread.join();
+    }
+}
+
+void ae::StatsReporter::Run()
+{
+    std::unique_lock lock(m_Mutex);
+
+    while (!m_Stop)
+    {
+        auto next = std::chrono::steady_clock::time_point::max();
+
+        for (const Report &report : m_Reports)
+        {
+            if (report.run)
+            {
+                next = std::min(next, report.due);
+            }
+        }
+
+        if (next == std::chrono::steady_clock::time_point::max())
+        {
+            m_Wake.wait(lock);
+            continue;
+        }
+
+        if (m_Wake.wait_until(lock, next) != std::cv_status::timeout)
+        {
+            // Woken to stop or for a changed schedule
+            continue;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+
+        for (Report &report : m_Reports)
+        {
+            if (!report.run || report.due > now)
+            {
+                continue;
+            }
+
+            report.due += report.interval;
+
+            // A report that ran long skips the intervals it missed instead of running back to back
+            if (report.due <= now)
+            {
+                report.due = now + report.interval;
+            }
+
+            // Logging can block on the async queue, the schedule may change meanwhile
+            const std::shared_ptr<std::function<void()>> run = report.run;
+            lock.unlock();
+
+            // A report that throws is reported once and kept on schedule, the thread must not end in std::terminate
+            try
+            {
+                (*run)();
+            }
+
+            catch (const std::exception &e)
+            {
+                if (!report.failed.exchange(true, std::memory_order_relaxed))
+                {
+                    std::println(stderr, "Periodic log report threw an exception\nMessage: {}", e.what());
+                }
+            }
+
+            lock.lock();
+
+            if (m_Stop)
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Log.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace ae
+{
+enum class StatsReportKind : uint8_t
+{
+    TIMER_STATS = 0,
+    HEALTH,
+    SINK_FLUSH, // Writes out lines that waited longer than a sink's flush interval
+    COUNT
+};
+
+// Runs the periodic reports and timed sink flushes of the Logger on a thread of its own, which only exists once a
+// report is scheduled
+class StatsReporter
+{
+  public:
+    StatsReporter();
+    ~StatsReporter();
+
+    StatsReporter(const StatsReporter &) = delete;
+    StatsReporter(StatsReporter &&) = delete;
+    StatsReporter &operator=(const StatsReporter &) = delete;
+    StatsReporter &operator=(StatsReporter &&) = delete;
+
+    // Calls report every interval from now on, replacing the earlier report of the kind. An interval of zero stops it.
+    // The same report object is called every time, so it may keep state between calls.
+    void Schedule(StatsReportKind kind, std::chrono::milliseconds interval, std::function<void()> report);
+    // Joins the thread, reports that are due are not run anymore
+    void Stop();
+
+  private:
+    struct Report
+    {
+        std::chrono::milliseconds interval{};
+        std::chrono::steady_clock::time_point due{};
+        // Shared so a run keeps its state, and its copy, while the report is replaced
+        std::shared_ptr<std::function<void()>> run;
+        std::atomic<bool> failed{ false }; // Written without the lock while the report runs, reset when replaced
+    };
+
+    void Run();
+
+  private:
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::array<Report, static_cast<size_t>(StatsReportKind::COUNT)> m_Reports;
+    std::thread m_Thread;
+    bool m_Stop;
+};
+} // namespace ae
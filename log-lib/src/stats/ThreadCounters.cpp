@@ -0,0 +1,102 @@
+#include "general/pch.h"
+
+#include "stats/ThreadCounters.h"
+
+#include <memory>
+#include <mutex>
+
+namespace
+{
+struct CounterSlot
+{
+    std::unique_ptr<ae::LogThreadCounters> counters;
+    bool owned;
+};
+
+struct CounterRegistry
+{
+    std::mutex mutex;
+    std::vector<CounterSlot> slots;
+    std::array<ae::LogLevelStats, ae::c_LogLevelCount> retired{};
+};
+
+CounterRegistry &GetRegistry()
+{
+    // Never destroyed, the Logger still counts its closing messages while statics are torn down
+    static CounterRegistry *registry = new CounterRegistry();
+    return *registry;
+}
+
+// Registers the thread's counters on construction and retires them when the thread exits
+struct CounterOwner
+{
+    ae::LogThreadCounters *counters;
+
+    CounterOwner() : counters(nullptr)
+    {
+        CounterRegistry &registry = GetRegistry();
+        std::scoped_lock lock(registry.mutex);
+
+        for (CounterSlot &slot : registry.slots)
+        {
+            if (!slot.owned)
+            {
+                slot.owned = true;
+                counters = slot.counters.get();
+                return;
+            }
+        }
+
+        registry.slots.push_back(CounterSlot{ .counters = std::make_unique<ae::LogThreadCounters>(), .owned = true });
+        counters = registry.slots.back().counters.get();
+    }
+
+    ~CounterOwner()
+    {
+        CounterRegistry &registry = GetRegistry();
+        std::scoped_lock lock(registry.mutex);
+
+        for (size_t i = 0; i < ae::c_LogLevelCount; ++i)
+        {
+            registry.retired[i].written += counters->written[i].exchange(0, std::memory_order_relaxed);
+            registry.retired[i].filtered += counters->filtered[i].exchange(0, std::memory_order_relaxed);
+        }
+
+        for (CounterSlot &slot : registry.slots)
+        {
+            if (slot.counters.get() == counters)
+            {
+                slot.owned = false;
+            }
+        }
+    }
+
+    CounterOwner(const CounterOwner &) = delete;
+    CounterOwner(CounterOwner &&) = delete;
+    CounterOwner &operator=(const CounterOwner &) = delete;
+    CounterOwner &operator=(CounterOwner &&) = delete;
+};
+} // namespace
+
+ae::LogThreadCounters &ae::GetLogThreadCounters()
+{
+    thread_local CounterOwner t_Owner;
+    return *t_Owner.counters;
+}
+
+void ae::SumLogThreadCounters(std::array<LogLevelStats, c_LogLevelCount> &levels)
+{
+    CounterRegistry &registry = GetRegistry();
+    std::scoped_lock lock(registry.mutex);
+
+    levels = registry.retired;
+
+    for (const CounterSlot &slot : registry.slots)
+    {
+        for (size_t i = 0; i < c_LogLevelCount; ++i)
+        {
+            levels[i].written += slot.counters->written[i].load(std::memory_order_relaxed);
+            levels[i].filtered += slot.counters->filtered[i].load(std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Log.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace ae
+{
+// Per-level message counts of one thread. Only the owning thread writes, with a load and a store, other threads
+// only sum them up.
+struct LogThreadCounters
+{
+    std::array<std::atomic<uint64_t>, c_LogLevelCount> written{};
+    std::array<std::atomic<uint64_t>, c_LogLevelCount> filtered{};
+
+    inline static void Increase(std::atomic<uint64_t> &counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+// The calling thread's counters, registered on first use. They are added to a shared total when the thread exits and
+// then handed to the next new thread.
+LogThreadCounters &GetLogThreadCounters();
+
+// The counts of every thread that ever counted
+void SumLogThreadCounters(std::array<LogLevelStats, c_LogLevelCount> &levels);
+} // namespace ae
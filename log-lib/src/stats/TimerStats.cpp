@@ -0,0 +1,155 @@
+#include "general/pch.h"
+
+namespace
+{
+struct TimerStatsRegistry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ae::TimerStats>> stats;
+};
+
+TimerStatsRegistry &GetRegistry()
+{
+    // Never destroyed, exiting threads and the Logger's reports can still reach it while statics are torn down
+    static TimerStatsRegistry *registry = new TimerStatsRegistry();
+    return *registry;
+}
+
+// Hands the histograms of the calling thread back when the thread exits
+struct TimerStatsOwner
+{
+    void (*release)(ae::TimerStats &stats, ae::LatencyHistogram *histogram) = nullptr;
+    std::vector<std::pair<ae::TimerStats *, ae::LatencyHistogram *>> histograms;
+
+    ~TimerStatsOwner();
+};
+} // namespace
+
+ae::TimerStats::TimerStats(std::string_view name, size_t index)
+    : m_Name(name), m_Index(index), m_Retired(std::make_unique<LatencyHistogram>()),
+      m_LastInterval(std::make_unique<LatencyHistogram>())
+{
+}
+
+ae::TimerStats &ae::TimerStats::Get(std::string_view name)
+{
+    TimerStatsRegistry &registry = GetRegistry();
+    std::scoped_lock lock(registry.mutex);
+
+    for (const std::unique_ptr<TimerStats> &stats : registry.stats)
+    {
+        if (stats->m_Name == name)
+        {
+            return *stats;
+        }
+    }
+
+    registry.stats.push_back(std::unique_ptr<TimerStats>(new TimerStats(name, registry.stats.size())));
+    return *registry.stats.back();
+}
+
+std::vector<ae::TimerStats *> ae::TimerStats::GetAll()
+{
+    TimerStatsRegistry &registry = GetRegistry();
+    std::scoped_lock lock(registry.mutex);
+
+    std::vector<TimerStats *> all;
+    all.reserve(registry.stats.size());
+
+    for (const std::unique_ptr<TimerStats> &stats : registry.stats)
+    {
+        all.push_back(stats.get());
+    }
+
+    return all;
+}
+
+ae::LatencySummary ae::TimerStats::GetSummary() const
+{
+    LatencyHistogram total;
+
+    {
+        std::scoped_lock lock(GetRegistry().mutex);
+        Merge(total);
+    }
+
+    return total.Summarize();
+}
+
+ae::LatencySummary ae::TimerStats::TakeIntervalSummary()
+{
+    LatencyHistogram interval;
+
+    {
+        std::scoped_lock lock(GetRegistry().mutex);
+        Merge(interval);
+
+        // The totals only grow, so they still contain what the previous interval reported
+        interval.Subtract(*m_LastInterval);
+        m_LastInterval->Add(interval);
+    }
+
+    return interval.Summarize();
+}
+
+ae::LatencyHistogram &ae::TimerStats::AttachHistogram()
+{
+    thread_local TimerStatsOwner t_Owner;
+
+    std::vector<LatencyHistogram *> &histograms = GetTimerStatsHistograms();
+
+    if (histograms.size() <= m_Index)
+    {
+        histograms.resize(m_Index + 1, nullptr);
+    }
+
+    std::scoped_lock lock(GetRegistry().mutex);
+    LatencyHistogram *histogram = nullptr;
+
+    if (!m_FreeHistograms.empty())
+    {
+        histogram = m_FreeHistograms.back();
+        m_FreeHistograms.pop_back();
+    }
+
+    else
+    {
+        m_Histograms.push_back(std::make_unique<LatencyHistogram>());
+        histogram = m_Histograms.back().get();
+    }
+
+    histograms[m_Index] = histogram;
+    t_Owner.release = &TimerStats::Release;
+    t_Owner.histograms.emplace_back(this, histogram);
+
+    return *histogram;
+}
+
+void ae::TimerStats::Merge(LatencyHistogram &total) const
+{
+    total.Add(*m_Retired);
+
+    for (const std::unique_ptr<LatencyHistogram> &histogram : m_Histograms)
+    {
+        // A free histogram is empty, its samples were moved to m_Retired
+        total.Add(*histogram);
+    }
+}
+
+void ae::TimerStats::Release(TimerStats &stats, LatencyHistogram *histogram)
+{
+    // The totals stay the same, the samples only move from one histogram to the other
+    stats.m_Retired->Add(*histogram);
+    histogram->Clear();
+    stats.m_FreeHistograms.push_back(histogram);
+}
+
+TimerStatsOwner::~TimerStatsOwner()
+{
+    std::scoped_lock lock(GetRegistry().mutex);
+
+    for (const auto &[stats, histogram] : histograms)
+    {
+        release(*stats, histogram);
+    }
+}
@@ -0,0 +1,158 @@
+#include "general/pch.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace
+{
+constexpr std::chrono::milliseconds c_TscCalibrationTime(10);
+constexpr std::chrono::seconds c_WallAnchorInterval(1);
+
+bool HasInvariantTsc()
+{
+#ifdef _MSC_VER
+#ifdef _M_X64
+    std::array<int, 4> registers{};
+    __cpuid(registers.data(), 0x80000000);
+
+    if (static_cast<uint32_t>(registers[0]) < 0x80000007)
+    {
+        return false;
+    }
+
+    __cpuid(registers.data(), 0x80000007);
+    return (registers[3] & (1 << 8)) != 0;
+#else
+    return false;
+#endif // _M_X64
+#elif defined(__x86_64__)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007 || !__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    {
+        return false;
+    }
+
+    return (edx & (1u << 8)) != 0;
+#else
+    return false;
+#endif // _MSC_VER
+}
+
+bool HasCoarseClock()
+{
+#ifdef AE_LINUX
+    timespec resolution{};
+    return clock_getres(CLOCK_MONOTONIC_COARSE, &resolution) == 0;
+#else
+    return false;
+#endif // AE_LINUX
+}
+
+int64_t SteadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// The wall clock that matches the source, the coarse clocks are updated on the same kernel tick
+std::chrono::system_clock::time_point WallNow([[maybe_unused]] ae::ClockSource source)
+{
+#ifdef AE_LINUX
+    if (source == ae::ClockSource::COARSE)
+    {
+        timespec now{};
+        clock_gettime(CLOCK_REALTIME_COARSE, &now);
+        return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec)));
+    }
+#endif // AE_LINUX
+
+    return std::chrono::system_clock::now();
+}
+} // namespace
+
+ae::ClockSource ae::Clock::Select(ClockSource source)
+{
+    static std::mutex s_SelectMutex;
+    std::scoped_lock lock(s_SelectMutex);
+
+    switch (source)
+    {
+    case ClockSource::COARSE:
+        if (!HasCoarseClock())
+        {
+            source = ClockSource::STD;
+        }
+        break;
+
+    case ClockSource::TSC:
+#if defined(__x86_64__) || defined(_M_X64)
+        if (HasInvariantTsc())
+        {
+            // Readings continue where steady_clock left off, so times taken before the switch still compare
+            const int64_t startNanos = SteadyNanos();
+            const uint64_t startCounter = ReadTsc();
+
+            std::this_thread::sleep_for(c_TscCalibrationTime);
+
+            const int64_t endNanos = SteadyNanos();
+            const uint64_t endCounter = ReadTsc();
+
+            if (endCounter > startCounter)
+            {
+                const double nanosPerTick =
+                    static_cast<double>(endNanos - startNanos) / static_cast<double>(endCounter - startCounter);
+
+                // Never freed, a thread may still be reading the previous calibration. Each Select leaks one.
+                const auto *calibration = new ClockTscCalibration{
+                    .counterBase = endCounter,
+                    .nanosBase = endNanos,
+                    .nanosPerTick = static_cast<uint64_t>(std::llround(nanosPerTick * 4294967296.0))
+                };
+
+                g_ClockTscCalibration.store(calibration, std::memory_order_release);
+                break;
+            }
+        }
+#endif
+        source = ClockSource::STD;
+        break;
+
+    default:
+        source = ClockSource::STD;
+        break;
+    }
+
+    g_ClockSource.store(source, std::memory_order_release);
+    return source;
+}
+
+std::chrono::system_clock::time_point ae::Clock::ToSystemTime(std::chrono::steady_clock::time_point time)
+{
+    struct WallAnchor
+    {
+        ClockSource source = ClockSource::STD;
+        std::chrono::steady_clock::time_point steady{};
+        std::chrono::system_clock::time_point wall{};
+    };
+
+    thread_local WallAnchor t_Anchor{};
+
+    const ClockSource source = GetSource();
+
+    // Older times, such as backtrace messages, are rendered against the newer anchor
+    if (t_Anchor.wall == std::chrono::system_clock::time_point{} || t_Anchor.source != source ||
+        time - t_Anchor.steady > c_WallAnchorInterval)
+    {
+        t_Anchor.source = source;
+        t_Anchor.steady = Now();
+        t_Anchor.wall = WallNow(source);
+    }
+
+    return t_Anchor.wall + std::chrono::duration_cast<std::chrono::system_clock::duration>(time - t_Anchor.steady);
+}
@@ -1 +1,62 @@
 #include "general/pch.h"
+
+namespace
+{
+const std::chrono::time_zone *TryGetCurrentZone() noexcept
+{
+    try
+    {
+        return std::chrono::current_zone();
+    }
+
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void WriteTwoDigits(char *out, int64_t value) noexcept
+{
+    out[0] = static_cast<char>('0' + (value / 10));
+    out[1] = static_cast<char>('0' + (value % 10));
+}
+} // namespace
+
+std::string_view ae::DateTime::LogTimeAsString(std::chrono::system_clock::time_point time)
+{
+    using namespace std::chrono;
+
+    struct Cache
+    {
+        sys_seconds second = sys_seconds::min();
+        std::array<char, 12> text{ '0', '0', ':', '0', '0', ':', '0', '0', '.', '0', '0', '0' };
+    };
+
+    // The zone is looked up once, without a TZ database the time is rendered in UTC
+    static const time_zone *zone = TryGetCurrentZone();
+    thread_local Cache cache;
+
+    const auto millis = floor<milliseconds>(time);
+    const auto second = floor<seconds>(millis);
+
+    if (second != cache.second)
+    {
+        const seconds sinceEpoch = (zone != nullptr) ? zone->to_local(second).time_since_epoch()
+                                                     : second.time_since_epoch();
+        const int64_t secondOfDay = ((sinceEpoch.count() % 86400) + 86400) % 86400;
+
+        WriteTwoDigits(cache.text.data(), secondOfDay / 3600);
+        WriteTwoDigits(cache.text.data() + 3, (secondOfDay / 60) % 60);
+        WriteTwoDigits(cache.text.data() + 6, secondOfDay % 60);
+
+        cache.second = second;
+    }
+
+    const auto fraction = (millis - second).count();
+
+    cache.text[9] = static_cast<char>('0' + (fraction / 100));
+    cache.text[10] = static_cast<char>('0' + ((fraction / 10) % 10));
+    cache.text[11] = static_cast<char>('0' + (fraction % 10));
+
+    return { cache.text.data(), cache.text.size() };
+}
@@ -6,7 +6,7 @@ ae::Timer::Timer() : m_ElapsedTime(std::chrono::steady_clock::duration::zero()),
 
 void ae::Timer::Start()
 {
-    m_Start = std::chrono::steady_clock::now();
+    m_Start = Clock::Now();
 
     m_Running = true;
 }
@@ -21,7 +21,7 @@ void ae::Timer::Stop()
     }
 #endif // AE_DEBUG
 
-    m_ElapsedTime += std::chrono::steady_clock::now() - m_Start;
+    m_ElapsedTime += Clock::Now() - m_Start;
 
     m_Running = false;
 }
@@ -39,7 +39,7 @@ double ae::Timer::GetElapsedTime() const
     auto duration = m_ElapsedTime;
     if (m_Running)
     {
-        duration += steady_clock::now() - m_Start;
+        duration += Clock::Now() - m_Start;
     }
 
     return duration_cast<std::chrono::duration<double>>(duration).count();
@@ -52,7 +52,7 @@ std::string ae::Timer::GetElapsedTimeAsString(int32_t decimals) const
     auto duration = m_ElapsedTime;
     if (m_Running)
     {
-        duration += steady_clock::now() - m_Start;
+        duration += Clock::Now() - m_Start;
     }
 
     auto h = duration_cast<hours>(duration);
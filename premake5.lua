@@ -113,6 +113,70 @@ includedirs({
 
 links({ "Log" })
 
+project("LogReader")
+kind("ConsoleApp")
+language("C++")
+cppdialect("C++23")
+objdir("obj/%{prj.name}/%{cfg.buildcfg}")
+targetdir("bin/%{prj.name}/%{cfg.buildcfg}")
+
+files({ "tools/log-reader/src/**.cpp", "tools/log-reader/src/**.h" })
+
+includedirs({
+	"log-lib/include",
+	"tools/log-reader/src",
+})
+
+links({ "Log" })
+
+project("LogDecode")
+kind("ConsoleApp")
+language("C++")
+cppdialect("C++23")
+objdir("obj/%{prj.name}/%{cfg.buildcfg}")
+targetdir("bin/%{prj.name}/%{cfg.buildcfg}")
+
+files({ "tools/log-decode/src/**.cpp", "tools/log-decode/src/**.h" })
+
+includedirs({
+	"log-lib/include",
+	"tools/log-decode/src",
+})
+
+links({ "Log" })
+
+project("Benchmark")
+kind("ConsoleApp")
+language("C++")
+cppdialect("C++23")
+objdir("obj/%{prj.name}/%{cfg.buildcfg}")
+targetdir("bin/%{prj.name}/%{cfg.buildcfg}")
+
+files({ "tools/benchmark/src/**.cpp", "tools/benchmark/src/**.h" })
+
+includedirs({
+	"log-lib/include",
+	"tools/benchmark/src",
+})
+
+links({ "Log" })
+
+project("AllocTest")
+kind("ConsoleApp")
+language("C++")
+cppdialect("C++23")
+objdir("obj/%{prj.name}/%{cfg.buildcfg}")
+targetdir("bin/%{prj.name}/%{cfg.buildcfg}")
+
+files({ "tools/alloc-test/src/**.cpp", "tools/alloc-test/src/**.h" })
+
+includedirs({
+	"log-lib/include",
+	"tools/alloc-test/src",
+})
+
+links({ "Log" })
+
 local function own_source_files()
 	local files = {}
 
@@ -132,6 +196,9 @@ local function own_source_files()
 	add("sandbox/src/**.h")
 	add("sandbox/src/**.hpp")
 
+	add("tools/**.cpp")
+	add("tools/**.h")
+
 	return files
 end
 
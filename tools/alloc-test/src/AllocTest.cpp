@@ -0,0 +1,136 @@
+#include "Log.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string_view>
+
+// Checks that logging does not allocate once call sites, thread-local buffers and sinks are warmed up. Every path is
+// run twice, the second run has to get by without a single call to operator new. Exits with 1 if any path allocated.
+// Build with the Debug or Release configuration, Dist removes every log call.
+
+namespace
+{
+std::atomic<uint64_t> g_Allocations{ 0 };
+
+void *Allocate(size_t size)
+{
+    g_Allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void *memory = std::malloc(size != 0 ? size : 1))
+    {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+} // namespace
+
+void *operator new(size_t size)
+{
+    return Allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+    return Allocate(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace
+{
+constexpr uint64_t c_Calls = 20000;
+constexpr std::string_view c_SinkName = "AllocTest";
+
+// Read through globals so the compiler can not format the messages ahead of time
+int g_Integer = 42;
+double g_Double = 3.14159265359;
+std::string g_String = "alloc-test-user";
+
+// Every message shape the hot path handles: no arguments, formatted arguments, a message longer than the buffers
+// start out with and structured fields
+void LogMessages(uint64_t calls)
+{
+    for (uint64_t i = 0; i < calls; ++i)
+    {
+        AE_LOG_BOTH(AE_INFO, "Message without any arguments");
+        AE_LOG_BOTH(AE_INFO, "Request {} from {} took {:.2f} ms", g_Integer, g_String, g_Double);
+        AE_LOG_BOTH(AE_WARNING, "{} {} {} {} {} {} {} {}", g_String, g_String, g_String, g_String, g_String, g_String,
+                    g_String, g_String);
+        AE_LOG_BOTH_KV(AE_INFO, "Request served", "id", g_Integer, "user", g_String, "ms", g_Double);
+    }
+
+    ae::Logger::Get().Flush();
+}
+
+// Runs the messages once to warm up and once counting, returns true if the second run did not allocate. The warm-up
+// has to pass through every slot of the async queue, each slot keeps the capacity of its own buffers.
+bool RunCase(std::string_view name)
+{
+    LogMessages(c_Calls);
+
+    const uint64_t before = g_Allocations.load(std::memory_order_relaxed);
+    LogMessages(c_Calls);
+    const uint64_t allocations = g_Allocations.load(std::memory_order_relaxed) - before;
+
+    std::println(stderr, "{}: {} allocations in {} messages", name, allocations, c_Calls * 4);
+    return allocations == 0;
+}
+} // namespace
+
+int main()
+{
+    ae::Logger &logger = ae::Logger::Get();
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ae-alloc-test";
+    const std::string name(c_SinkName);
+    bool passed = true;
+
+    std::filesystem::create_directories(directory);
+
+    logger.AddFileSink(name, (directory / "file.log").string());
+    passed = RunCase("file") && passed;
+    logger.RemoveSink(name);
+
+    logger.AddBufferedFileSink(name, (directory / "buffered.log").string());
+    passed = RunCase("buffered") && passed;
+    logger.RemoveSink(name);
+
+    logger.AddStructuredFileSink(name, (directory / "structured.json").string());
+    passed = RunCase("structured") && passed;
+
+    // Async logging can not be turned off again, so it runs last
+    logger.EnableAsync();
+    passed = RunCase("async") && passed;
+    logger.RemoveSink(name);
+
+    std::error_code ec;
+    std::filesystem::remove_all(directory, ec);
+
+    if (!passed)
+    {
+        std::println(stderr, "Logging allocated after warm-up");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,340 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <latch>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef AE_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif // AE_WINDOWS
+
+// Measures what a log call costs for every combination of sink, argument mix and producer thread count, and prints
+// the results as JSON so runs can be compared. Build with the Release configuration, Dist removes every log call.
+
+namespace
+{
+// Read through globals so the compiler can not format the messages ahead of time
+int g_Integer = 42;
+double g_Double = 3.14159265359;
+std::string g_String = "benchmark-user";
+const char *g_Address = "10.0.0.1";
+bool g_Flag = true;
+
+typedef void (*LogCall)();
+
+struct ArgumentMix
+{
+    std::string_view name;
+    LogCall trace; // Below the sinks' range in the disabled case
+    LogCall info;
+    size_t bytes;  // Length of the formatted message
+};
+
+template <ae::LogLevel Level> void LogNone()
+{
+    AE_LOG_BOTH(Level, "Benchmark message without any arguments");
+}
+
+template <ae::LogLevel Level> void LogInteger()
+{
+    AE_LOG_BOTH(Level, "Processed item {}", g_Integer);
+}
+
+template <ae::LogLevel Level> void LogNumbers()
+{
+    AE_LOG_BOTH(Level, "Position {} {:.3f} {:.3f}", g_Integer, g_Double, g_Double * 2.0);
+}
+
+template <ae::LogLevel Level> void LogString()
+{
+    AE_LOG_BOTH(Level, "User {} logged in", g_String);
+}
+
+template <ae::LogLevel Level> void LogMixed()
+{
+    AE_LOG_BOTH(Level, "Request {} from {} took {:.2f} ms, cached: {}", g_Integer, g_Address, g_Double, g_Flag);
+}
+
+std::vector<ArgumentMix> MakeArgumentMixes()
+{
+    return {
+        { "none", &LogNone<ae::LogLevel::TRACE>, &LogNone<ae::LogLevel::INFO>,
+          std::formatted_size("Benchmark message without any arguments") },
+        { "int", &LogInteger<ae::LogLevel::TRACE>, &LogInteger<ae::LogLevel::INFO>,
+          std::formatted_size("Processed item {}", g_Integer) },
+        { "int_double", &LogNumbers<ae::LogLevel::TRACE>, &LogNumbers<ae::LogLevel::INFO>,
+          std::formatted_size("Position {} {:.3f} {:.3f}", g_Integer, g_Double, g_Double * 2.0) },
+        { "string", &LogString<ae::LogLevel::TRACE>, &LogString<ae::LogLevel::INFO>,
+          std::formatted_size("User {} logged in", g_String) },
+        { "mixed", &LogMixed<ae::LogLevel::TRACE>, &LogMixed<ae::LogLevel::INFO>,
+          std::formatted_size("Request {} from {} took {:.2f} ms, cached: {}", g_Integer, g_Address, g_Double,
+                              g_Flag) },
+    };
+}
+
+enum class SinkCase : uint8_t
+{
+    DISABLED = 0, // The sink does not take the level, the call only checks its call site
+    NULL_SINK,    // Formats and dispatches, the sink does nothing
+    FILE,
+    CONSOLE, // stdout, which the benchmark points at the null device
+};
+
+constexpr std::array<std::string_view, 4> c_SinkNames = { "disabled", "null", "file", "console" };
+
+constexpr std::string_view c_SinkName = "Benchmark";
+
+void AddSink(SinkCase sink, const std::filesystem::path &filePath)
+{
+    ae::Logger &logger = ae::Logger::Get();
+
+    switch (sink)
+    {
+    case SinkCase::DISABLED:
+        logger.AddCallbackSink(std::string(c_SinkName), [](const ae::LogMessage &, std::string_view) {}, AE_WARNING);
+        break;
+    case SinkCase::NULL_SINK:
+        logger.AddCallbackSink(std::string(c_SinkName), [](const ae::LogMessage &, std::string_view) {});
+        break;
+    case SinkCase::FILE:
+        logger.AddFileSink(std::string(c_SinkName), filePath.string());
+        break;
+    case SinkCase::CONSOLE:
+        logger.AddConsoleSink(std::string(c_SinkName));
+        break;
+    }
+}
+
+struct CaseResult
+{
+    uint64_t calls = 0;
+    double seconds = 0.0;
+    ae::LatencySummary latency; // Percentiles as defined by ae::LatencyHistogram, empty unless timed
+};
+
+// Runs iterations calls on each thread, either back to back for throughput or timing every call for latency
+CaseResult RunThreads(LogCall call, uint32_t threads, uint64_t iterations, bool timed)
+{
+    CaseResult result;
+    std::vector<ae::LatencyHistogram> histograms(timed ? threads : 0);
+    std::vector<std::thread> workers;
+    std::latch ready(threads + 1);
+    std::latch start(1);
+
+    for (uint32_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back(
+            [&, t]()
+            {
+                ready.count_down();
+                start.wait();
+
+                if (!timed)
+                {
+                    for (uint64_t i = 0; i < iterations; ++i)
+                    {
+                        call();
+                    }
+
+                    return;
+                }
+
+                ae::LatencyHistogram &histogram = histograms[t];
+
+                for (uint64_t i = 0; i < iterations; ++i)
+                {
+                    const auto before = std::chrono::steady_clock::now();
+                    call();
+                    const auto after = std::chrono::steady_clock::now();
+
+                    histogram.Record(static_cast<uint64_t>((after - before).count()));
+                }
+            });
+    }
+
+    ready.arrive_and_wait();
+    const auto begin = std::chrono::steady_clock::now();
+    start.count_down();
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    ae::Logger::Get().Flush();
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.calls = iterations * threads;
+
+    ae::LatencyHistogram latency;
+
+    for (const ae::LatencyHistogram &histogram : histograms)
+    {
+        latency.Add(histogram);
+    }
+
+    result.latency = latency.Summarize();
+    return result;
+}
+
+// Cost of reading the clock twice, which is included in every latency sample
+uint64_t MeasureTimerOverhead()
+{
+    ae::LatencyHistogram histogram;
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        const auto before = std::chrono::steady_clock::now();
+        const auto after = std::chrono::steady_clock::now();
+        histogram.Record(static_cast<uint64_t>((after - before).count()));
+    }
+
+    return static_cast<uint64_t>(histogram.Summarize().p50.count());
+}
+
+// Keeps a handle to the real stdout for the report and sends everything else written to stdout to the null device
+FILE *RedirectStdout()
+{
+#ifdef AE_WINDOWS
+    FILE *report = _fdopen(_dup(_fileno(stdout)), "w");
+    FILE *ignored = nullptr;
+    freopen_s(&ignored, "NUL", "w", stdout);
+#else
+    FILE *report = fdopen(dup(fileno(stdout)), "w");
+
+    if (std::freopen("/dev/null", "w", stdout) == nullptr)
+    {
+        std::fclose(report);
+        return nullptr;
+    }
+#endif // AE_WINDOWS
+
+    return report;
+}
+
+bool ParseCount(std::string_view text, uint64_t &value)
+{
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size() && value != 0;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    uint64_t iterations = 100000;
+    uint64_t maxThreads = std::clamp<uint64_t>(std::thread::hardware_concurrency(), 1, 8);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--iterations" && hasValue && ParseCount(argv[i + 1], iterations))
+        {
+            ++i;
+        }
+
+        else if (arg == "--threads" && hasValue && ParseCount(argv[i + 1], maxThreads))
+        {
+            ++i;
+        }
+
+        else
+        {
+            std::println(stderr, "Usage: Benchmark [--iterations <calls per thread>] [--threads <max threads>]");
+            return 1;
+        }
+    }
+
+    std::vector<uint32_t> threadCounts;
+
+    for (uint64_t threads = 1; threads < maxThreads; threads *= 2)
+    {
+        threadCounts.push_back(static_cast<uint32_t>(threads));
+    }
+
+    threadCounts.push_back(static_cast<uint32_t>(maxThreads));
+
+    FILE *report = RedirectStdout();
+
+    if (report == nullptr)
+    {
+        std::println(stderr, "Failed to send stdout to the null device");
+        return 1;
+    }
+
+    const std::filesystem::path filePath = std::filesystem::temp_directory_path() / "ae-benchmark.log";
+    const std::vector<ArgumentMix> mixes = MakeArgumentMixes();
+    const uint64_t timerOverhead = MeasureTimerOverhead();
+
+    std::println(report, "{{");
+    std::println(report, "  \"version\": \"{}\",", c_LogLibVersion);
+    std::println(report, "  \"iterationsPerThread\": {},", iterations);
+    std::println(report, "  \"timerOverheadNs\": {},", timerOverhead);
+    std::println(report, "  \"results\": [");
+
+    bool first = true;
+
+    for (size_t s = 0; s < c_SinkNames.size(); ++s)
+    {
+        const auto sink = static_cast<SinkCase>(s);
+
+        for (const ArgumentMix &mix : mixes)
+        {
+            const LogCall call = sink == SinkCase::DISABLED ? mix.trace : mix.info;
+
+            for (const uint32_t threads : threadCounts)
+            {
+                std::println(stderr, "{} / {} / {} threads", c_SinkNames[s], mix.name, threads);
+
+                AddSink(sink, filePath);
+
+                // Warms up call sites, thread-local buffers and the file before anything is measured
+                RunThreads(call, threads, std::max<uint64_t>(iterations / 10, 1), false);
+
+                const CaseResult throughput = RunThreads(call, threads, iterations, false);
+                const CaseResult latency = RunThreads(call, threads, iterations, true);
+
+                ae::Logger::Get().RemoveSink(std::string(c_SinkName));
+
+                const double nsPerCall = throughput.seconds * 1e9 * threads / static_cast<double>(throughput.calls);
+                const double messagesPerSecond = static_cast<double>(throughput.calls) / throughput.seconds;
+                const double bytesPerSecond =
+                    sink == SinkCase::DISABLED ? 0.0 : messagesPerSecond * static_cast<double>(mix.bytes);
+
+                std::println(report, "{}    {{", first ? "" : ",\n");
+                std::println(report, "      \"sink\": \"{}\",", c_SinkNames[s]);
+                std::println(report, "      \"arguments\": \"{}\",", mix.name);
+                std::println(report, "      \"threads\": {},", threads);
+                std::println(report, "      \"calls\": {},", throughput.calls);
+                std::println(report, "      \"nsPerCall\": {:.2f},", nsPerCall);
+                std::println(report, "      \"messagesPerSecond\": {:.0f},", messagesPerSecond);
+                std::println(report, "      \"bytesPerSecond\": {:.0f},", bytesPerSecond);
+                std::println(report, "      \"latencyNs\": {{ \"p50\": {}, \"p99\": {}, \"p999\": {}, \"max\": {} }}",
+                             latency.latency.p50.count(), latency.latency.p99.count(),
+                             latency.latency.p999.count(), latency.latency.max.count());
+                std::print(report, "    }}");
+
+                first = false;
+            }
+        }
+    }
+
+    std::println(report, "\n  ]");
+    std::println(report, "}}");
+    std::fclose(report);
+
+    std::error_code ec;
+    std::filesystem::remove(filePath, ec);
+
+    return 0;
+}
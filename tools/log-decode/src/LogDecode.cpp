@@ -0,0 +1,72 @@
+#include "Log.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+// Turns a file written by ae::Logger::AddBinaryFileSink back into text. With --follow it keeps waiting for new records
+// once the end of the file is reached, like tail -f.
+int main(int argc, char **argv)
+{
+    const bool follow = argc == 3 && std::strcmp(argv[1], "--follow") == 0;
+
+    if (argc != 2 && !follow)
+    {
+        std::println(stderr, "Usage: LogDecode [--follow] <binary log file>");
+        return 1;
+    }
+
+    const char *path = argv[argc - 1];
+    FILE *file = nullptr;
+
+#ifdef AE_WINDOWS
+    fopen_s(&file, path, "rb");
+#else
+    file = std::fopen(path, "rb");
+#endif
+
+    if (file == nullptr)
+    {
+        std::println(stderr, "Failed to open '{}'", path);
+        return 1;
+    }
+
+    ae::BinaryLogDecoder decoder;
+    std::array<char, 64 * 1024> chunk{};
+    std::string text;
+
+    try
+    {
+        while (true)
+        {
+            const size_t read = std::fread(chunk.data(), 1, chunk.size(), file);
+
+            if (read == 0)
+            {
+                if (!follow || std::ferror(file))
+                {
+                    break;
+                }
+
+                std::fflush(stdout);
+                std::clearerr(file);
+                ae::DateTime::Wait(0.2);
+                continue;
+            }
+
+            text.clear();
+            decoder.Feed({ chunk.data(), read }, text);
+            std::fwrite(text.data(), 1, text.size(), stdout);
+        }
+    }
+
+    catch (const std::exception &e)
+    {
+        std::fclose(file);
+        std::println(stderr, "{}", e.what());
+        return 1;
+    }
+
+    std::fclose(file);
+    return 0;
+}
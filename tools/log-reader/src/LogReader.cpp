@@ -0,0 +1,25 @@
+#include "Log.h"
+
+// Prints the contents of a ring log file written by ae::Logger::AddRingFileSink, oldest line first
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        std::println(stderr, "Usage: LogReader <ring log file>");
+        return 1;
+    }
+
+    try
+    {
+        const std::string text = ae::ReadRingLogFile(argv[1]);
+        std::fwrite(text.data(), 1, text.size(), stdout);
+    }
+
+    catch (const std::exception &e)
+    {
+        std::println(stderr, "{}", e.what());
+        return 1;
+    }
+
+    return 0;
+}